@@ -0,0 +1,186 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Copyright(c) 2023 Koko Software. All rights reserved.
+//
+// Author: Adrian Warecki <embedded@kokosoftware.pl>
+
+#include "types.hpp"
+#include "AddressIndex.hpp"
+
+#include <algorithm>
+#include <bit>
+
+using namespace elf;
+
+// Rank of symbols sharing the same address, lower is preferred
+static int binding_rank(const Elf32_Sym *sym) {
+	switch (ELF32_ST_BIND(sym->info)) {
+		case STB_GLOBAL:
+			return 0;
+		case STB_WEAK:
+			return 1;
+		default:
+			return 2;
+	}
+}
+
+AddressIndex::AddressIndex(const SymbolTable &symtab)
+	: symbols(symtab), strings(symtab.get_strings())
+{
+	for (const Elf32_Sym &sym : symtab.symbols()) {
+		const int type = ELF32_ST_TYPE(sym.info);
+
+		if ((type != STT_FUNC && type != STT_OBJECT) || sym.shndx == SHN_UNDEF)
+			continue;
+
+		entries.push_back(&sym);
+	}
+
+	std::sort(entries.begin(), entries.end(), [](const Elf32_Sym *a, const Elf32_Sym *b) {
+		if (a->value != b->value)
+			return a->value < b->value;
+		return binding_rank(a) < binding_rank(b);
+	});
+
+	// Keep only the preferred alias of each address
+	entries.erase(std::unique(entries.begin(), entries.end(), [](const Elf32_Sym *a, const Elf32_Sym *b) {
+		return a->value == b->value;
+	}), entries.end());
+
+	build();
+}
+
+// Layout: count, symbol indexes in address order
+AddressIndex::AddressIndex(const SymbolTable &symtab, std::span<const uint32_t> data)
+	: symbols(symtab), strings(symtab.get_strings())
+{
+	const std::span<const Elf32_Sym> syms = symtab.symbols();
+
+	if (data.empty() || data.size() != 1 + size_t(data[0]))
+		throw Exception("Invalid address index.");
+
+	entries.reserve(data[0]);
+	for (uint32_t idx : data.subspan(1)) {
+		if (idx >= syms.size())
+			throw Exception("Invalid address index.");
+
+		entries.push_back(&syms[idx]);
+	}
+
+	build();
+}
+
+void AddressIndex::save(std::vector<uint32_t> &out) const {
+	const Elf32_Sym *base = reinterpret_cast<const Elf32_Sym*>(symbols.data().data());
+
+	out.push_back(static_cast<uint32_t>(entries.size()));
+	for (const Elf32_Sym *sym : entries)
+		out.push_back(static_cast<uint32_t>(sym - base));
+}
+
+// Values and the search tree of the sorted entries
+void AddressIndex::build() {
+	values.reserve(entries.size());
+	for (const Elf32_Sym *sym : entries)
+		values.push_back(sym->value);
+
+	tree.resize(values.size() + 1);
+	rank.resize(values.size() + 1);
+
+	size_t pos = 0;
+	build_tree(pos, 1);
+}
+
+// In-order walk of the implicit tree assigns sorted values to the nodes
+void AddressIndex::build_tree(size_t &pos, size_t node) {
+	if (node > values.size())
+		return;
+
+	build_tree(pos, node * 2);
+	tree[node] = values[pos];
+	rank[node] = static_cast<uint32_t>(pos++);
+	build_tree(pos, node * 2 + 1);
+}
+
+// Location of address given the position of the first symbol above it
+AddressIndex::Location AddressIndex::locate(size_t pos, uint32_t address) const {
+	if (!pos)
+		return { nullptr, {}, 0 };
+
+	const Elf32_Sym *sym = entries[pos - 1];
+	const uint32_t offset = address - sym->value;
+
+	// Symbols without size extend up to the next one
+	if (sym->size && offset >= sym->size)
+		return { nullptr, {}, 0 };
+
+	return { sym, strings.get(sym->name), offset };
+}
+
+AddressIndex::Location AddressIndex::lookup(uint32_t address) const {
+	const size_t count = values.size();
+	size_t node = 1;
+
+	// Descend to the first value greater than address
+	while (node <= count)
+		node = node * 2 + (tree[node] <= address);
+
+	// Drop trailing right turns, what remains is the node of the upper bound
+	node >>= std::countr_one(node) + 1;
+
+	return locate(node ? rank[node] : count, address);
+}
+
+// Stable LSD radix sort on the upper 32 bits of the keys, two 16-bit digits
+static void sort_keys(std::vector<uint64_t> &keys) {
+	if (keys.size() < 4096) {
+		std::sort(keys.begin(), keys.end());
+		return;
+	}
+
+	std::vector<uint64_t> temp(keys.size());
+	std::vector<size_t> count(0x10000);
+
+	for (unsigned int shift = 32; shift < 64; shift += 16) {
+		std::fill(count.begin(), count.end(), 0);
+
+		for (uint64_t key : keys)
+			count[(key >> shift) & 0xFFFF]++;
+
+		size_t sum = 0;
+		for (size_t &c : count) {
+			size_t n = c;
+			c = sum;
+			sum += n;
+		}
+
+		for (uint64_t key : keys)
+			temp[count[(key >> shift) & 0xFFFF]++] = key;
+
+		keys.swap(temp);
+	}
+}
+
+std::vector<AddressIndex::Location> AddressIndex::lookup(std::span<const uint32_t> addresses) const {
+	// Address in the upper half and query position in the lower half sort as plain integers
+	std::vector<uint64_t> order(addresses.size());
+	for (size_t idx = 0; idx < addresses.size(); idx++)
+		order[idx] = uint64_t(addresses[idx]) << 32 | idx;
+
+	sort_keys(order);
+
+	std::vector<Location> result(addresses.size());
+	size_t pos = 0;
+
+	for (uint64_t key : order) {
+		const uint32_t address = static_cast<uint32_t>(key >> 32);
+		const uint32_t idx = static_cast<uint32_t>(key);
+
+		while (pos < values.size() && values[pos] <= address)
+			pos++;
+
+		result[idx] = locate(pos, address);
+	}
+
+	return result;
+}
@@ -0,0 +1,62 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright(c) 2023 Koko Software. All rights reserved.
+ *
+ * Author: Adrian Warecki <embedded@kokosoftware.pl>
+ */
+
+#ifndef __ADDRESS_INDEX_HPP__
+#define __ADDRESS_INDEX_HPP__
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "Elf.hpp"
+
+namespace elf {
+	// Immutable address to symbol index over STT_FUNC and STT_OBJECT symbols.
+	// Single lookups search an Eytzinger (BFS) ordered copy of the addresses,
+	// batches are sorted and merged with the plain sorted array.
+	class AddressIndex {
+		public:
+			struct Location {
+				const Elf32_Sym *symbol;	// nullptr if no symbol covers the address
+				std::string_view name;
+				uint32_t offset;		// Offset from the symbol value
+			};
+
+			AddressIndex(const SymbolTable &symtab);
+			// Restore from save() data of the same symbol table, nothing is sorted again
+			AddressIndex(const SymbolTable &symtab, std::span<const uint32_t> data);
+
+			// Flat copy of the index for persistent caches
+			void save(std::vector<uint32_t> &out) const;
+
+			Location lookup(uint32_t address) const;
+			// Results are returned in the order of the addresses
+			std::vector<Location> lookup(std::span<const uint32_t> addresses) const;
+
+			size_t size() const { return values.size(); }
+
+		private:
+			// Keep the symbol and string buffers alive
+			Section symbols;
+			StringsTable strings;
+
+			// Symbols sorted by value
+			std::vector<uint32_t> values;
+			std::vector<const Elf32_Sym*> entries;
+
+			// Eytzinger layout of values (1-based) and their sorted positions
+			std::vector<uint32_t> tree;
+			std::vector<uint32_t> rank;
+
+			void build();
+			void build_tree(size_t &pos, size_t node);
+			Location locate(size_t pos, uint32_t address) const;
+	};
+};
+
+#endif /* __ADDRESS_INDEX_HPP__ */
@@ -0,0 +1,138 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Copyright(c) 2023 Koko Software. All rights reserved.
+//
+// Author: Adrian Warecki <embedded@kokosoftware.pl>
+
+#include "types.hpp"
+#include "Arena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+using namespace elf;
+
+static constexpr size_t page_size = 4096;
+
+static size_t round_up(size_t value, size_t granularity) {
+	return (value + granularity - 1) / granularity * granularity;
+}
+
+Arena::Arena(bool huge_pages, size_t block_size)
+	: huge_pages(huge_pages), block_size(huge_pages ? std::max(block_size, huge_page_size) : block_size)
+{
+	next_size = std::min(first_block_size, this->block_size);
+}
+
+Arena::~Arena() {
+	for (const Block &block : blocks)
+		unmap(block);
+}
+
+size_t Arena::size() const {
+	std::lock_guard<std::mutex> guard(lock);
+	return used;
+}
+
+size_t Arena::capacity() const {
+	std::lock_guard<std::mutex> guard(lock);
+	return reserved;
+}
+
+void *Arena::do_allocate(size_t bytes, size_t alignment) {
+	std::lock_guard<std::mutex> guard(lock);
+	size_t pad = (alignment - reinterpret_cast<uintptr_t>(current) % alignment) % alignment;
+
+	if (!current || pad + bytes > left) {
+		// Large buffers get a block of their own, the current block stays in use
+		if (bytes > block_size / 4) {
+			const Block block = map(bytes);
+			blocks.push_back(block);
+			used += bytes;
+			return block.data;
+		}
+
+		const Block block = map(std::max(next_size, bytes));
+		blocks.push_back(block);
+		next_size = std::min(next_size * 2, block_size);
+		current = static_cast<std::byte*>(block.data);
+		left = block.size;
+		pad = 0;
+	}
+
+	void *ptr = current + pad;
+	current += pad + bytes;
+	left -= pad + bytes;
+	used += bytes;
+	return ptr;
+}
+
+#ifdef _WIN32
+Arena::Block Arena::map(size_t size) {
+	void *data = nullptr;
+
+	// Large pages require the SeLockMemoryPrivilege, fall back to regular pages without it
+	const SIZE_T large = GetLargePageMinimum();
+	if (huge_pages && large && size >= large) {
+		data = VirtualAlloc(nullptr, round_up(size, large), MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+				    PAGE_READWRITE);
+		if (data)
+			size = round_up(size, large);
+	}
+
+	if (!data) {
+		size = round_up(size, page_size);
+		data = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	}
+
+	if (!data)
+		throw std::bad_alloc();
+
+	reserved += size;
+	return { data, size };
+}
+
+void Arena::unmap(const Block &block) {
+	VirtualFree(block.data, 0, MEM_RELEASE);
+}
+#else
+Arena::Block Arena::map(size_t size) {
+	const bool huge = huge_pages && size >= huge_page_size;
+	void *data = MAP_FAILED;
+
+	size = round_up(size, huge ? huge_page_size : page_size);
+
+#ifdef MAP_HUGETLB
+	// Succeeds only when the system has reserved huge pages
+	if (huge)
+		data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+
+	if (data == MAP_FAILED) {
+		data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (data == MAP_FAILED)
+			throw std::bad_alloc();
+
+#ifdef MADV_HUGEPAGE
+		// Transparent huge pages
+		if (huge)
+			madvise(data, size, MADV_HUGEPAGE);
+#endif
+	}
+
+	reserved += size;
+	return { data, size };
+}
+
+void Arena::unmap(const Block &block) {
+	munmap(block.data, block.size);
+}
+#endif
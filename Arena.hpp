@@ -0,0 +1,65 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright(c) 2023 Koko Software. All rights reserved.
+ *
+ * Author: Adrian Warecki <embedded@kokosoftware.pl>
+ */
+
+#ifndef __ARENA_HPP__
+#define __ARENA_HPP__
+
+#include <cstddef>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+namespace elf {
+	// Monotonic allocator for the buffers of a single Elf. Nothing is freed until the
+	// arena is destroyed, then all blocks are returned to the system at once. Blocks
+	// grow from first_block_size up to block_size, so small files stay cheap. Blocks
+	// of huge page size are backed by huge pages on request, when the system allows it.
+	// Allocation is thread safe.
+	class Arena : public std::pmr::memory_resource {
+		public:
+			static constexpr size_t default_block_size = 1024 * 1024;
+			static constexpr size_t huge_page_size = 2 * 1024 * 1024;
+			static constexpr size_t first_block_size = 64 * 1024;
+
+			Arena(bool huge_pages = false, size_t block_size = default_block_size);
+			~Arena();
+
+			Arena(const Arena&) = delete;
+			Arena &operator=(const Arena&) = delete;
+
+			// Bytes handed out and bytes reserved from the system
+			size_t size() const;
+			size_t capacity() const;
+
+		private:
+			struct Block {
+				void *data;
+				size_t size;
+			};
+
+			bool huge_pages;
+			size_t block_size;
+			size_t next_size;
+			std::vector<Block> blocks;
+			std::byte *current = nullptr;
+			size_t left = 0;
+			size_t used = 0;
+			size_t reserved = 0;
+			mutable std::mutex lock;
+
+			void *do_allocate(size_t bytes, size_t alignment) override;
+			void do_deallocate(void *, size_t, size_t) override {}
+			bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+				return this == &other;
+			}
+
+			Block map(size_t size);
+			static void unmap(const Block &block);
+	};
+};
+
+#endif /* __ARENA_HPP__ */
@@ -0,0 +1,566 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Copyright(c) 2023 Koko Software. All rights reserved.
+//
+// Author: Adrian Warecki <embedded@kokosoftware.pl>
+
+#include "types.hpp"
+#include "AsyncReader.hpp"
+#include "Elf.hpp"
+#include "Image.hpp"
+#include "PositionalFile.hpp"
+#include "ThreadPool.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define ELF_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+using namespace elf;
+
+struct AsyncReader::Request {
+	const PositionalFile *file;
+	uint64_t offset;
+	std::span<std::byte> buffer;
+	Handler handler;
+#ifdef ELF_IO_URING
+	iovec vector = {};
+#endif
+};
+
+#ifdef ELF_IO_URING
+// Submission and completion rings shared with the kernel. Requests are submitted by any
+// thread under the lock, a single thread reaps completions and resubmits short reads.
+// When the ring fails, requests the kernel does not own are failed through their handlers.
+class AsyncReader::Ring {
+	public:
+		Ring(AsyncReader &owner, unsigned int depth);
+		~Ring();
+
+		void submit(Request *request);
+
+	private:
+		AsyncReader &owner;
+		int fd;
+
+		void *sq_ring = MAP_FAILED;
+		void *cq_ring = MAP_FAILED;
+		io_uring_sqe *sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+		size_t sq_ring_size = 0;
+		size_t cq_ring_size = 0;
+		size_t sqes_size = 0;
+
+		unsigned int *sq_tail;
+		unsigned int *sq_mask;
+		unsigned int *sq_array;
+		unsigned int *cq_head;
+		unsigned int *cq_tail;
+		unsigned int *cq_mask;
+		io_uring_cqe *cqes;
+		unsigned int entries;
+
+		std::mutex lock;
+		std::condition_variable wake;
+		std::deque<Request*> backlog;
+		std::unordered_set<Request*> active;	// Requests owned by the kernel
+		unsigned int pending = 0;		// Queued entries not passed to the kernel yet
+		bool stop = false;
+		bool broken = false;
+		std::thread reaper;
+
+		void push(Request *request);
+		std::vector<Request*> flush();
+		void reap();
+		void fail(const std::vector<Request*> &requests, const char *message);
+		void release();
+
+		static int enter(int fd, unsigned int submit, unsigned int complete, unsigned int flags) {
+			return static_cast<int>(syscall(__NR_io_uring_enter, fd, submit, complete, flags, nullptr, 0));
+		}
+};
+
+AsyncReader::Ring::Ring(AsyncReader &owner, unsigned int depth)
+	: owner(owner)
+{
+	io_uring_params params = {};
+
+	fd = static_cast<int>(syscall(__NR_io_uring_setup, depth, &params));
+	if (fd < 0)
+		throw Exception("Cannot create io_uring.");
+
+	sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+
+	// Both rings share one mapping on newer kernels
+	const bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+	if (single)
+		sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+
+	sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (sq_ring != MAP_FAILED)
+		cq_ring = single ? sq_ring : mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+						  fd, IORING_OFF_CQ_RING);
+	if (cq_ring != MAP_FAILED)
+		sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+						       fd, IORING_OFF_SQES));
+
+	if (sqes == MAP_FAILED) {
+		release();
+		throw Exception("Cannot map io_uring.");
+	}
+
+	auto *sq = static_cast<unsigned char*>(sq_ring);
+	auto *cq = static_cast<unsigned char*>(cq_ring);
+	sq_tail = reinterpret_cast<unsigned int*>(sq + params.sq_off.tail);
+	sq_mask = reinterpret_cast<unsigned int*>(sq + params.sq_off.ring_mask);
+	sq_array = reinterpret_cast<unsigned int*>(sq + params.sq_off.array);
+	cq_head = reinterpret_cast<unsigned int*>(cq + params.cq_off.head);
+	cq_tail = reinterpret_cast<unsigned int*>(cq + params.cq_off.tail);
+	cq_mask = reinterpret_cast<unsigned int*>(cq + params.cq_off.ring_mask);
+	cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+	// The completion ring is at least as large, it cannot overflow
+	entries = params.sq_entries;
+
+	reaper = std::thread(&Ring::reap, this);
+}
+
+// The owner has waited for all requests, the reaper is idle
+AsyncReader::Ring::~Ring() {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stop = true;
+		wake.notify_one();
+	}
+
+	reaper.join();
+	release();
+}
+
+void AsyncReader::Ring::release() {
+	if (sqes != MAP_FAILED)
+		munmap(sqes, sqes_size);
+	if (cq_ring != MAP_FAILED && cq_ring != sq_ring)
+		munmap(cq_ring, cq_ring_size);
+	if (sq_ring != MAP_FAILED)
+		munmap(sq_ring, sq_ring_size);
+	close(fd);
+}
+
+void AsyncReader::Ring::submit(Request *request) {
+	std::vector<Request*> failed;
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		backlog.push_back(request);
+		failed = flush();
+	}
+
+	fail(failed, "io_uring submission failed.");
+}
+
+// Fill the next submission entry, the caller holds the lock and a free slot
+void AsyncReader::Ring::push(Request *request) {
+	const unsigned int tail = *sq_tail;
+	const unsigned int slot = tail & *sq_mask;
+	io_uring_sqe &sqe = sqes[slot];
+
+	request->vector = { request->buffer.data(), request->buffer.size() };
+
+	std::memset(&sqe, 0, sizeof(sqe));
+	sqe.opcode = IORING_OP_READV;
+	sqe.fd = request->file->fd;
+	sqe.off = request->offset;
+	sqe.addr = reinterpret_cast<uintptr_t>(&request->vector);
+	sqe.len = 1;
+	sqe.user_data = reinterpret_cast<uintptr_t>(request);
+
+	sq_array[slot] = slot;
+	std::atomic_ref<unsigned int>(*sq_tail).store(tail + 1, std::memory_order_release);
+	active.insert(request);
+	pending++;
+}
+
+// Move the backlog into free slots and pass all queued entries to the kernel. Returns
+// the requests to fail when the submission fails, the ring is not used after that.
+std::vector<AsyncReader::Request*> AsyncReader::Ring::flush() {
+	std::vector<Request*> failed;
+
+	while (!broken && !backlog.empty() && active.size() < entries) {
+		push(backlog.front());
+		backlog.pop_front();
+	}
+
+	while (pending) {
+		const int ret = enter(fd, pending, 0, 0);
+		if (ret >= 0) {
+			pending -= ret;
+			continue;
+		}
+
+		if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+			continue;
+
+		// Entries the kernel did not consume are taken back from the ring
+		const unsigned int tail = *sq_tail;
+		for (unsigned int idx = tail - pending; idx != tail; idx++) {
+			Request *request = reinterpret_cast<Request*>(sqes[idx & *sq_mask].user_data);
+			active.erase(request);
+			failed.push_back(request);
+		}
+
+		std::atomic_ref<unsigned int>(*sq_tail).store(tail - pending, std::memory_order_release);
+		pending = 0;
+		broken = true;
+	}
+
+	if (broken) {
+		failed.insert(failed.end(), backlog.begin(), backlog.end());
+		backlog.clear();
+	}
+
+	if (!active.empty())
+		wake.notify_one();
+
+	return failed;
+}
+
+// Called without the lock, the handlers may submit new requests
+void AsyncReader::Ring::fail(const std::vector<Request*> &requests, const char *message) {
+	for (Request *request : requests)
+		owner.finish(request, std::make_exception_ptr(Exception(message)));
+}
+
+// Waits in the kernel only while it owns a request, a completion is certain to come
+void AsyncReader::Ring::reap() {
+	std::vector<std::pair<Request*, int>> completed;
+	std::vector<Request*> again;
+	std::vector<Request*> failed;
+
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			wake.wait(guard, [this] { return stop || !active.empty(); });
+			if (active.empty())
+				return;
+		}
+
+		if (enter(fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+			// Nothing will complete anymore
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				broken = true;
+				failed.assign(active.begin(), active.end());
+				failed.insert(failed.end(), backlog.begin(), backlog.end());
+				active.clear();
+				backlog.clear();
+			}
+
+			fail(failed, "io_uring completion failed.");
+			return;
+		}
+
+		unsigned int head = *cq_head;
+		const unsigned int tail = std::atomic_ref<unsigned int>(*cq_tail).load(std::memory_order_acquire);
+
+		completed.clear();
+		for (; head != tail; head++) {
+			const io_uring_cqe &cqe = cqes[head & *cq_mask];
+			completed.emplace_back(reinterpret_cast<Request*>(cqe.user_data), cqe.res);
+		}
+		std::atomic_ref<unsigned int>(*cq_head).store(head, std::memory_order_release);
+
+		again.clear();
+		for (auto [request, res] : completed) {
+			// Interrupted and short reads continue where they stopped
+			if (res == -EINTR || res == -EAGAIN) {
+				again.push_back(request);
+				continue;
+			}
+
+			if (res > 0 && static_cast<size_t>(res) < request->buffer.size()) {
+				request->buffer = request->buffer.subspan(res);
+				request->offset += res;
+				again.push_back(request);
+				continue;
+			}
+
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				active.erase(request);
+			}
+
+			if (res <= 0)
+				owner.finish(request, std::make_exception_ptr(Exception("File read error.")));
+			else
+				owner.finish(request, nullptr);
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(lock);
+
+			// Resubmitted requests go ahead of the backlog
+			for (Request *request : again) {
+				active.erase(request);
+				backlog.push_front(request);
+			}
+
+			failed = flush();
+		}
+
+		fail(failed, "io_uring submission failed.");
+	}
+}
+#else
+class AsyncReader::Ring {
+	public:
+		Ring(AsyncReader &, unsigned int) {
+			throw Exception("io_uring is not supported.");
+		}
+
+		void submit(Request *) {}
+};
+#endif
+
+AsyncReader::AsyncReader(unsigned int depth, Backend backend) {
+	depth = std::max(depth, 1u);
+
+	if (backend == Backend::Auto) {
+		try {
+			ring = std::make_unique<Ring>(*this, depth);
+		}
+		catch (std::exception &) {
+			// Old kernel or io_uring disabled by the system policy
+		}
+	}
+
+	if (!ring)
+		pool = std::make_unique<ThreadPool>(depth);
+}
+
+AsyncReader::~AsyncReader() {
+	try {
+		wait();
+	}
+	catch (...) {
+		// Exceptions of handlers are only reported by wait() called explicitly
+	}
+
+	ring.reset();
+	pool.reset();
+}
+
+void AsyncReader::wait() {
+	std::unique_lock<std::mutex> guard(lock);
+	idle.wait(guard, [this] { return !unfinished; });
+
+	if (handler_error)
+		std::rethrow_exception(std::exchange(handler_error, nullptr));
+}
+
+void AsyncReader::submit(std::unique_ptr<Request> request) {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		unfinished++;
+	}
+
+	if (request->buffer.empty()) {
+		finish(request.release(), nullptr);
+		return;
+	}
+
+	if (ring) {
+		ring->submit(request.release());
+		return;
+	}
+
+	pool->submit([this, request = request.release()] {
+		std::exception_ptr error;
+
+		try {
+			request->file->read(request->buffer.data(), request->buffer.size(), request->offset);
+		}
+		catch (...) {
+			error = std::current_exception();
+		}
+
+		finish(request, error);
+	});
+}
+
+void AsyncReader::finish(Request *request, std::exception_ptr error) {
+	std::unique_ptr<Request> owned(request);
+	std::exception_ptr thrown;
+
+	try {
+		owned->handler(error);
+	}
+	catch (...) {
+		thrown = std::current_exception();
+	}
+	owned.reset();
+
+	std::lock_guard<std::mutex> guard(lock);
+	if (thrown && !handler_error)
+		handler_error = thrown;
+
+	if (!--unfinished)
+		idle.notify_all();
+}
+
+std::pair<AsyncReader::Handler, std::future<void>> AsyncReader::make_future() {
+	auto promise = std::make_shared<std::promise<void>>();
+	std::future<void> future = promise->get_future();
+
+	Handler handler = [promise](std::exception_ptr error) {
+		if (error)
+			promise->set_exception(error);
+		else
+			promise->set_value();
+	};
+
+	return { std::move(handler), std::move(future) };
+}
+
+void AsyncReader::read(const PositionalFile &file, uint64_t offset, std::span<std::byte> buffer, Handler handler) {
+	submit(std::unique_ptr<Request>(new Request{ &file, offset, buffer, std::move(handler) }));
+}
+
+std::future<void> AsyncReader::read(const PositionalFile &file, uint64_t offset, std::span<std::byte> buffer) {
+	auto [handler, future] = make_future();
+
+	read(file, offset, buffer, std::move(handler));
+	return std::move(future);
+}
+
+void AsyncReader::read_section(Elf &elf, unsigned int index, Section &section, Handler handler) {
+	if (index >= elf.sections.size())
+		throw String(_T("Invalid section index."));
+
+	const SectionHeader &header = elf.sections[index];
+
+	// Nothing to wait for, or decoded by the caller thread
+	if (elf.mapping || header.type == SHT_NOBITS || (header.flags & SHF_COMPRESSED) || elf.cache.get(index)) {
+		std::exception_ptr error;
+
+		try {
+			elf.read_section(section, index);
+		}
+		catch (...) {
+			error = std::current_exception();
+		}
+
+		handler(error);
+		return;
+	}
+
+	section.header = header;
+	unsigned char *data = section.allocate(header.size, elf.arena);
+
+	read(*elf.file, header.off, std::span<std::byte>(reinterpret_cast<std::byte*>(data), header.size),
+	     [&elf, index, &section, handler = std::move(handler)](std::exception_ptr error) {
+		if (!error) {
+			elf.cache.put(index, section.buffer, section.header.size);
+#ifdef ELF_STATS
+			ElfStats::add(elf.stats.read_calls, 1);
+			ElfStats::add(elf.stats.bytes_read, section.header.size);
+			ElfStats::add(elf.stats.allocations, 1);
+			ElfStats::add(elf.stats.bytes_allocated, section.header.size);
+#endif
+		}
+
+		handler(error);
+	});
+}
+
+std::future<void> AsyncReader::read_section(Elf &elf, unsigned int index, Section &section) {
+	auto [handler, future] = make_future();
+
+	read_section(elf, index, section, std::move(handler));
+	return std::move(future);
+}
+
+void AsyncReader::read_image(Elf &elf, ImageInterface &image, Handler handler) {
+	if (elf.mapping) {
+		std::exception_ptr error;
+
+		try {
+			elf.read_image(image);
+		}
+		catch (...) {
+			error = std::current_exception();
+		}
+
+		handler(error);
+		return;
+	}
+
+	struct State {
+		std::mutex lock;
+		size_t remaining;
+		std::exception_ptr error;
+		Handler handler;
+	};
+
+	struct Target {
+		const Elf64_Phdr *header;
+		std::span<std::byte> data;
+	};
+
+	// All memory is taken before the first read can complete
+	std::vector<Target> targets;
+	for (const Elf64_Phdr &hdr : elf.programs)
+		if (hdr.type == PT_LOAD && hdr.filesz)
+			targets.push_back({ &hdr, image.process(hdr.paddr, hdr.memsz) });
+
+	if (targets.empty()) {
+		handler(nullptr);
+		return;
+	}
+
+	auto state = std::make_shared<State>();
+	state->remaining = targets.size();
+	state->handler = std::move(handler);
+
+	for (const Target &target : targets) {
+		read(*elf.file, target.header->off, target.data.first(target.header->filesz),
+		     [state, &image, target](std::exception_ptr error) {
+			std::unique_lock<std::mutex> guard(state->lock);
+
+			if (error) {
+				if (!state->error)
+					state->error = error;
+			} else {
+				std::memset(target.data.data() + target.header->filesz, 0,
+					    target.header->memsz - target.header->filesz);
+				image.complete(target.header->paddr, target.data);
+			}
+
+			if (--state->remaining)
+				return;
+
+			guard.unlock();
+			state->handler(state->error);
+		});
+	}
+}
+
+std::future<void> AsyncReader::read_image(Elf &elf, ImageInterface &image) {
+	auto [handler, future] = make_future();
+
+	read_image(elf, image, std::move(handler));
+	return std::move(future);
+}
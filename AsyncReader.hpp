@@ -0,0 +1,94 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright(c) 2023 Koko Software. All rights reserved.
+ *
+ * Author: Adrian Warecki <embedded@kokosoftware.pl>
+ */
+
+#ifndef __ASYNC_READER_HPP__
+#define __ASYNC_READER_HPP__
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <utility>
+
+namespace elf {
+	class Elf;
+	class Section;
+	class ImageInterface;
+	class PositionalFile;
+	class ThreadPool;
+
+	// Batched asynchronous reads across many files. On Linux an io_uring is driven
+	// directly through its system calls, elsewhere or when the kernel refuses a ring
+	// a pool of threads issues positional reads. Requests over the queue depth wait in
+	// a backlog, submitting never blocks.
+	//
+	// Handlers run on the reader threads, concurrently in the thread fallback. They may
+	// submit further requests but must not wait for them. The first exception thrown by
+	// a handler is rethrown by wait().
+	class AsyncReader {
+		public:
+			// Receives nullptr on success
+			using Handler = std::function<void(std::exception_ptr error)>;
+
+			enum class Backend {
+				Auto,		// io_uring when available, threads otherwise
+				Threads,	// One thread per queue slot
+			};
+
+			static constexpr unsigned int default_depth = 64;
+
+			AsyncReader(unsigned int depth = default_depth, Backend backend = Backend::Auto);
+			// Waits for all requests
+			~AsyncReader();
+
+			AsyncReader(const AsyncReader &) = delete;
+			AsyncReader &operator=(const AsyncReader &) = delete;
+
+			// Fill the whole buffer with the file content at offset
+			void read(const PositionalFile &file, uint64_t offset, std::span<std::byte> buffer, Handler handler);
+			std::future<void> read(const PositionalFile &file, uint64_t offset, std::span<std::byte> buffer);
+
+			// Elf::read_section, both objects must stay alive until the handler runs. Sections of
+			// mapped files, cached and compressed sections are read before the call returns.
+			void read_section(Elf &elf, unsigned int index, Section &section, Handler handler);
+			std::future<void> read_section(Elf &elf, unsigned int index, Section &section);
+
+			// Elf::read_image, segments are completed in any order but never concurrently
+			void read_image(Elf &elf, ImageInterface &image, Handler handler);
+			std::future<void> read_image(Elf &elf, ImageInterface &image);
+
+			// Wait until all submitted requests are finished, rethrows a handler exception
+			void wait();
+
+			bool uses_io_uring() const { return ring != nullptr; }
+
+		private:
+			struct Request;
+			class Ring;
+
+			std::unique_ptr<Ring> ring;
+			std::unique_ptr<ThreadPool> pool;
+
+			std::mutex lock;
+			std::condition_variable idle;
+			size_t unfinished = 0;
+			std::exception_ptr handler_error;
+
+			void submit(std::unique_ptr<Request> request);
+			void finish(Request *request, std::exception_ptr error);
+
+			// Handler fulfilling the promise of the returned future
+			static std::pair<Handler, std::future<void>> make_future();
+	};
+};
+
+#endif /* __ASYNC_READER_HPP__ */
@@ -0,0 +1,264 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Copyright(c) 2023 Koko Software. All rights reserved.
+//
+// Author: Adrian Warecki <embedded@kokosoftware.pl>
+
+#include "types.hpp"
+#include "Elf.hpp"
+#include "ElfGenerator.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#define dup _dup
+#define dup2 _dup2
+#define close _close
+#define fileno _fileno
+static const char null_device[] = "NUL";
+#else
+#include <unistd.h>
+static const char null_device[] = "/dev/null";
+#endif
+
+using namespace elf;
+
+struct Options {
+	unsigned int sections = 1000;
+	unsigned int symbols = 100000;
+	size_t strtab_size = 0;
+	unsigned int repeat = 5;
+	std::string label = "current";
+	std::string output;
+};
+
+struct Result {
+	std::string name;
+	size_t operations;	// Operations in a single run
+	double best;		// Nanoseconds per operation
+	double median;
+};
+
+// Time repeat runs of func, each performing the given number of operations
+template <typename F>
+static Result measure(const char *name, size_t operations, unsigned int repeat, F &&func) {
+	std::vector<double> times;
+
+	for (unsigned int run = 0; run < repeat; run++) {
+		const auto start = std::chrono::steady_clock::now();
+		func();
+		const auto end = std::chrono::steady_clock::now();
+
+		times.push_back(std::chrono::duration<double, std::nano>(end - start).count() / operations);
+	}
+
+	std::sort(times.begin(), times.end());
+	return { name, operations, times.front(), times[times.size() / 2] };
+}
+
+// Discard stdout while print() is measured
+class Silence {
+	public:
+		Silence() {
+			fflush(stdout);
+			saved = dup(fileno(stdout));
+			if (!freopen(null_device, "w", stdout))
+				throw Exception("Cannot redirect stdout.");
+		}
+
+		~Silence() {
+			fflush(stdout);
+			dup2(saved, fileno(stdout));
+			close(saved);
+		}
+
+	private:
+		int saved;
+};
+
+static Options parse_options(int argc, char **argv) {
+	Options options;
+
+	for (int idx = 1; idx < argc; idx++) {
+		const std::string arg = argv[idx];
+
+		if (idx + 1 >= argc)
+			throw Exception("Missing value of " + arg);
+
+		const char *value = argv[++idx];
+		if (arg == "--sections")
+			options.sections = static_cast<unsigned int>(std::stoul(value));
+		else if (arg == "--symbols")
+			options.symbols = static_cast<unsigned int>(std::stoul(value));
+		else if (arg == "--strtab")
+			options.strtab_size = std::stoull(value);
+		else if (arg == "--repeat")
+			options.repeat = std::max(1u, static_cast<unsigned int>(std::stoul(value)));
+		else if (arg == "--label")
+			options.label = value;
+		else if (arg == "--output")
+			options.output = value;
+		else
+			throw Exception("Unknown option " + arg);
+	}
+
+	return options;
+}
+
+// Contents of a JSON string literal
+static std::string json_escape(const std::string &text) {
+	std::string out;
+
+	for (const char c : text) {
+		if (c == '"' || c == '\\') {
+			out += '\\';
+			out += c;
+		} else if (static_cast<unsigned char>(c) < 0x20) {
+			char code[8];
+			snprintf(code, sizeof(code), "\\u%04x", c);
+			out += code;
+		} else {
+			out += c;
+		}
+	}
+
+	return out;
+}
+
+static void report(FILE *out, const Options &options, uintmax_t file_size, const std::vector<Result> &results) {
+	fprintf(out, "{\n");
+	fprintf(out, "  \"benchmark\": \"elf\",\n");
+	fprintf(out, "  \"label\": \"%s\",\n", json_escape(options.label).c_str());
+	fprintf(out, "  \"config\": {\"sections\": %u, \"symbols\": %u, \"strtab_size\": %zu, \"file_size\": %ju, \"repeat\": %u},\n",
+		options.sections, options.symbols, options.strtab_size, file_size, options.repeat);
+	fprintf(out, "  \"results\": [\n");
+
+	for (size_t idx = 0; idx < results.size(); idx++) {
+		const Result &result = results[idx];
+		fprintf(out, "    {\"name\": \"%s\", \"operations\": %zu, \"best_ns_per_op\": %.2f, \"median_ns_per_op\": %.2f, \"ops_per_sec\": %.0f}%s\n",
+			result.name.c_str(), result.operations, result.best, result.median, 1e9 / result.median,
+			idx + 1 < results.size() ? "," : "");
+	}
+
+	fprintf(out, "  ]\n}\n");
+}
+
+static std::vector<Result> run(const Options &options, const std::filesystem::path &path,
+			       const ElfGenerator &generator) {
+	std::vector<Result> results;
+	const unsigned int repeat = options.repeat;
+	const unsigned int constructions = 20;
+
+	results.push_back(measure("construct_stream", constructions, repeat, [&] {
+		for (unsigned int idx = 0; idx < constructions; idx++)
+			Elf elf(path);
+	}));
+
+	results.push_back(measure("construct_mapped", constructions, repeat, [&] {
+		for (unsigned int idx = 0; idx < constructions; idx++)
+			Elf elf(path, Elf::Access::Mapped);
+	}));
+
+	results.push_back(measure("construct_arena", constructions, repeat, [&] {
+		for (unsigned int idx = 0; idx < constructions; idx++)
+			Elf elf(path, Elf::Access::Arena);
+	}));
+
+	Elf elf(path);
+	elf.set_cache_budget(0);
+	const size_t sections = elf.get_sections().size();
+
+	results.push_back(measure("read_section_stream", sections - 1, repeat, [&] {
+		Section section;
+		for (unsigned int idx = 1; idx < sections; idx++)
+			elf.read_section(section, idx);
+	}));
+
+	Elf mapped(path, Elf::Access::Mapped);
+	results.push_back(measure("read_section_mapped", sections - 1, repeat, [&] {
+		Section section;
+		for (unsigned int idx = 1; idx < sections; idx++)
+			mapped.read_section(section, idx);
+	}));
+
+	std::vector<std::string> section_names;
+	for (unsigned int idx = 0; idx < generator.get_sections(); idx++)
+		section_names.push_back(generator.section_name(idx));
+
+	int found = 0;
+	results.push_back(measure("find_section", section_names.size(), repeat, [&] {
+		for (const std::string &name : section_names)
+			found += mapped.find_section(name) > 0;
+	}));
+
+	SymbolTable symtab;
+	mapped.read_symbols(symtab);
+	const std::span<const Elf32_Sym> symbols = symtab.symbols();
+
+	size_t length = 0;
+	results.push_back(measure("string_lookup", symbols.size(), repeat, [&] {
+		for (const Elf32_Sym &sym : symbols)
+			length += symtab.get_strings().get(sym.name).size();
+	}));
+
+	std::vector<std::string> symbol_names;
+	for (unsigned int idx = 0; idx < generator.get_symbols(); idx++)
+		symbol_names.push_back(generator.symbol_name(idx));
+
+	// The first run includes building the name index
+	results.push_back(measure("symbol_lookup", symbol_names.size(), repeat, [&] {
+		for (const std::string &name : symbol_names)
+			found += symtab.find(name) != nullptr;
+	}));
+
+	results.push_back(measure("print", symbols.size(), repeat, [&] {
+		Silence silence;
+		mapped.print();
+		symtab.print();
+	}));
+
+	if (found != static_cast<int>((section_names.size() + symbol_names.size()) * repeat) || !length)
+		throw Exception("Lookup of a generated name failed.");
+
+	return results;
+}
+
+int main(int argc, char **argv) {
+	try {
+		const Options options = parse_options(argc, argv);
+		const ElfGenerator generator(options.sections, options.symbols, options.strtab_size);
+		const std::filesystem::path path = std::filesystem::temp_directory_path() / "elf_benchmark.elf";
+
+		generator.write(path);
+		const uintmax_t file_size = std::filesystem::file_size(path);
+		const std::vector<Result> results = run(options, path, generator);
+		std::filesystem::remove(path);
+
+		FILE *out = stdout;
+		if (!options.output.empty()) {
+			out = fopen(options.output.c_str(), "w");
+			if (!out)
+				throw Exception("Cannot open " + options.output);
+		}
+
+		report(out, options, file_size, results);
+
+		if (out != stdout)
+			fclose(out);
+	}
+	catch (std::exception& err) {
+		fprintf(stderr, "Error: %s\n", err.what());
+		return 1;
+	}
+	catch (String& err) {
+		fwprintf(stderr, L"Error: %ls\n", err.c_str());
+		return 1;
+	}
+
+	return 0;
+}
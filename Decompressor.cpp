@@ -0,0 +1,130 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Copyright(c) 2023 Koko Software. All rights reserved.
+//
+// Author: Adrian Warecki <embedded@kokosoftware.pl>
+
+#include "types.hpp"
+#include "Decompressor.hpp"
+#include "elf.h"
+
+#include <algorithm>
+#include <climits>
+
+#ifdef ELF_ZLIB
+#include <zlib.h>
+#define ELF_HAVE_ZLIB
+#endif
+
+#ifdef ELF_ZSTD
+#include <zstd.h>
+#define ELF_HAVE_ZSTD
+#endif
+
+using namespace elf;
+
+struct Decompressor::State {
+#ifdef ELF_HAVE_ZLIB
+	z_stream zlib = {};
+#endif
+#ifdef ELF_HAVE_ZSTD
+	ZSTD_DCtx *zstd = nullptr;
+#endif
+};
+
+bool Decompressor::supported(uint32_t type) {
+	switch (type) {
+#ifdef ELF_HAVE_ZLIB
+		case ELFCOMPRESS_ZLIB:
+			return true;
+#endif
+#ifdef ELF_HAVE_ZSTD
+		case ELFCOMPRESS_ZSTD:
+			return true;
+#endif
+		default:
+			return false;
+	}
+}
+
+Decompressor::Decompressor(uint32_t type)
+	: type(type), state(std::make_unique<State>())
+{
+	if (!supported(type))
+		throw Exception("Unsupported section compression.");
+
+#ifdef ELF_HAVE_ZLIB
+	if (type == ELFCOMPRESS_ZLIB && inflateInit(&state->zlib) != Z_OK)
+		throw Exception("Cannot initialize zlib decompression.");
+#endif
+#ifdef ELF_HAVE_ZSTD
+	if (type == ELFCOMPRESS_ZSTD && !(state->zstd = ZSTD_createDCtx()))
+		throw Exception("Cannot initialize zstd decompression.");
+#endif
+}
+
+Decompressor::~Decompressor() {
+#ifdef ELF_HAVE_ZLIB
+	if (type == ELFCOMPRESS_ZLIB)
+		inflateEnd(&state->zlib);
+#endif
+#ifdef ELF_HAVE_ZSTD
+	if (type == ELFCOMPRESS_ZSTD)
+		ZSTD_freeDCtx(state->zstd);
+#endif
+}
+
+// Parameters are unused in builds without any codec
+bool Decompressor::run([[maybe_unused]] std::span<const std::byte> &input,
+		       [[maybe_unused]] std::span<std::byte> &output) {
+#ifdef ELF_HAVE_ZLIB
+	if (type == ELFCOMPRESS_ZLIB) {
+		z_stream &zs = state->zlib;
+
+		// Lengths are 32 bit, larger spans are processed in steps. Stop when no progress is possible.
+		for (;;) {
+			const uInt in_size = static_cast<uInt>(std::min<size_t>(input.size(), UINT_MAX));
+			const uInt out_size = static_cast<uInt>(std::min<size_t>(output.size(), UINT_MAX));
+
+			zs.next_in = reinterpret_cast<Bytef*>(const_cast<std::byte*>(input.data()));
+			zs.avail_in = in_size;
+			zs.next_out = reinterpret_cast<Bytef*>(output.data());
+			zs.avail_out = out_size;
+
+			const int ret = inflate(&zs, Z_NO_FLUSH);
+			input = input.subspan(in_size - zs.avail_in);
+			output = output.subspan(out_size - zs.avail_out);
+
+			if (ret == Z_STREAM_END)
+				return true;
+			if (ret == Z_BUF_ERROR)
+				return false;
+			if (ret != Z_OK)
+				throw Exception("Corrupted zlib compressed section.");
+		}
+	}
+#endif
+#ifdef ELF_HAVE_ZSTD
+	if (type == ELFCOMPRESS_ZSTD) {
+		size_t ret;
+
+		// Zero once a frame is completely decoded and flushed
+		do {
+			ZSTD_inBuffer in = { input.data(), input.size(), 0 };
+			ZSTD_outBuffer out = { output.data(), output.size(), 0 };
+
+			ret = ZSTD_decompressStream(state->zstd, &out, &in);
+			if (ZSTD_isError(ret))
+				throw Exception("Corrupted zstd compressed section.");
+
+			input = input.subspan(in.pos);
+			output = output.subspan(out.pos);
+			if (!in.pos && !out.pos)
+				break;
+		} while (ret);
+
+		return ret == 0;
+	}
+#endif
+	return false;
+}
@@ -0,0 +1,43 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright(c) 2023 Koko Software. All rights reserved.
+ *
+ * Author: Adrian Warecki <embedded@kokosoftware.pl>
+ */
+
+#ifndef __DECOMPRESSOR_HPP__
+#define __DECOMPRESSOR_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+namespace elf {
+	// Incremental decoder of SHF_COMPRESSED section data. Every codec is opt-in: define
+	// ELF_ZLIB or ELF_ZSTD and link zlib or libzstd to enable it. The projects define
+	// neither, so by default compressed sections throw "Unsupported section compression."
+	class Decompressor {
+		public:
+			// Throws for a compression type not supported by this build
+			Decompressor(uint32_t type);
+			~Decompressor();
+
+			Decompressor(const Decompressor&) = delete;
+			Decompressor &operator=(const Decompressor&) = delete;
+
+			static bool supported(uint32_t type);
+
+			// Decode from input into output, both are advanced past the processed bytes.
+			// Returns true once the end of the compressed stream is reached.
+			bool run(std::span<const std::byte> &input, std::span<std::byte> &output);
+
+		private:
+			struct State;
+
+			uint32_t type;
+			std::unique_ptr<State> state;
+	};
+};
+
+#endif /* __DECOMPRESSOR_HPP__ */
@@ -6,18 +6,25 @@
 
 #include "types.hpp"
 #include "Elf.hpp"
+#include "StringsIndex.hpp"
+#include "Image.hpp"
+#include "HashedImage.hpp"
+#include "ElfTraits.hpp"
+#include "Decompressor.hpp"
+
+#include <algorithm>
+#include <cinttypes>
 
 using namespace elf;
 
 SectionHeader::SectionHeader() {
-	std::memset(dynamic_cast<Elf32_Shdr*>(this), 0, sizeof(Elf32_Shdr));
+	std::memset(dynamic_cast<Elf64_Shdr*>(this), 0, sizeof(Elf64_Shdr));
 }
 
-SectionHeader::SectionHeader(std::istream *stream, std::streamsize file_size) {
-	stream->read(reinterpret_cast<char*>(
-		dynamic_cast<Elf32_Shdr*>(this)), sizeof(Elf32_Shdr));
-
-	if (file_size && (type != SHT_NOBITS && (off + size > file_size)))
+SectionHeader::SectionHeader(const Elf64_Shdr &hdr, std::streamsize file_size)
+	: Elf64_Shdr(hdr)
+{
+	if (file_size && (type != SHT_NOBITS && (size > uint64_t(file_size) || off > file_size - size)))
 		throw Exception("Invalid section header.");
 }
 
@@ -25,35 +32,91 @@ void SectionHeader::update_name(const StringsTable &str) {
 	name_str = str.get(name);
 }
 
-void Section::read(std::istream* stream, const SectionHeader* header, std::streamsize file_size) {
+void Section::read(std::istream* stream, const SectionHeader* header, std::streamsize file_size,
+		   const std::shared_ptr<Arena> &arena) {
 	if (header->type == SHT_NOBITS)
 		throw Exception("Cannot read SHT_NOBITS section.");
 
 	this->header = *header;
 
-	if (file_size && (header->off + header->size > file_size))
+	if (file_size && (header->size > uint64_t(file_size) || header->off > file_size - header->size))
 		throw Exception("Invalid section position in file.");
 
-	buffer = std::shared_ptr<unsigned char[]>(new unsigned char[header->size]);
+	unsigned char *data = allocate(header->size, arena);
+
 	stream->seekg(header->off, std::ios_base::beg);
-	stream->read(reinterpret_cast<char*>(buffer.get()), header->size);
+	stream->read(reinterpret_cast<char*>(data), header->size);
 }
 
+void Section::read(const PositionalFile &file, const SectionHeader* header, const std::shared_ptr<Arena> &arena) {
+	if (header->type == SHT_NOBITS)
+		throw Exception("Cannot read SHT_NOBITS section.");
+
+	if (header->size > file.size() || header->off > file.size() - header->size)
+		throw Exception("Invalid section position in file.");
 
+	this->header = *header;
+	unsigned char *data = allocate(header->size, arena);
 
-std::string StringsTable::get(unsigned int index) const {
-	// TODO: Check index, return string from buffer
-	return std::string(reinterpret_cast<const char*>(buffer.get() + index));
+	file.read(data, header->size, header->off);
+}
+
+void Section::read(const std::shared_ptr<const MappedFile> &file, const SectionHeader* header) {
+	if (header->type == SHT_NOBITS)
+		throw Exception("Cannot read SHT_NOBITS section.");
+
+	this->header = *header;
+
+	if (header->size > file->size() || header->off > file->size() - header->size)
+		throw Exception("Invalid section position in file.");
+
+	// Share ownership of the mapping, no copy is made
+	auto data = reinterpret_cast<const unsigned char*>(file->data().data()) + header->off;
+	buffer = std::shared_ptr<const unsigned char[]>(file, data);
+}
+
+unsigned char *Section::allocate(size_t size, const std::shared_ptr<Arena> &arena) {
+	unsigned char *data;
+
+	if (arena) {
+		// No control block of its own, the buffer keeps the whole arena alive
+		data = static_cast<unsigned char*>(arena->allocate(size, alignof(std::max_align_t)));
+		buffer = std::shared_ptr<const unsigned char[]>(arena, data);
+	} else {
+		std::shared_ptr<unsigned char[]> owned(new unsigned char[size]);
+		data = owned.get();
+		buffer = owned;
+	}
+
+	return data;
+}
+
+std::span<const std::byte> Section::data() const {
+	return { reinterpret_cast<const std::byte*>(buffer.get()), header.size };
+}
+
+
+
+// Returned view is followed by a NUL terminator within the section
+std::string_view StringsTable::get(unsigned int index) const {
+	if (index >= header.size)
+		throw Exception("Invalid string index.");
+
+	const char *str = reinterpret_cast<const char*>(buffer.get() + index);
+	const void *end = std::memchr(str, '\0', header.size - index);
+	if (!end)
+		throw Exception("Unterminated string.");
+
+	return std::string_view(str, static_cast<const char*>(end) - str);
 }
 
 void StringsTable::print()
 {
-	const char *str = reinterpret_cast<const char *>(buffer.get());
-	const char *end = str + header.size;
-	while (str < end) {
-		int len = strlen(str);
-		printf("%s\n", str);
-		str += len + 1;
+	StringsIndex index(*this);
+
+	for (size_t idx = 0; idx < index.size(); idx++) {
+		std::string_view str = index[idx];
+		printf("%.*s\n", static_cast<int>(str.size()), str.data());
 	}
 }
 
@@ -68,21 +131,241 @@ typedef struct {
 } Elf32_Sym;
 #endif
 
-uint32_t SymbolTable::get(std::string name) {
-	return 0;
+void SymbolTable::link(const StringsTable &str, std::pmr::memory_resource *resource) {
+	strings = str;
+	// The resource of a pmr container is fixed at construction
+	std::destroy_at(&index);
+	std::construct_at(&index, resource);
+	index_guard.ready = false;
+	hash_type = HashType::None;
+}
+
+std::span<const Elf32_Sym> SymbolTable::symbols() const {
+	return { reinterpret_cast<const Elf32_Sym *>(buffer.get()), header.size / sizeof(Elf32_Sym) };
+}
+
+// SysV ABI symbol hash function
+static uint32_t elf_hash(std::string_view name) {
+	uint32_t h = 0;
+
+	for (unsigned char c : name) {
+		h = (h << 4) + c;
+		uint32_t g = h & 0xf0000000;
+		if (g)
+			h ^= g >> 24;
+		h &= ~g;
+	}
+
+	return h;
+}
+
+void SymbolTable::attach_hash(const Section &table) {
+	const SectionHeader &hdr = table.get_header();
+	auto words = reinterpret_cast<const uint32_t *>(table.data().data());
+	const size_t count = table.data().size() / sizeof(uint32_t);
+	const size_t symnum = symbols().size();
+
+	hash_type = HashType::None;
+
+	if (hdr.type == SHT_HASH) {
+		if (count < 2 || count - 2 < size_t(words[0]) + words[1] || words[1] > symnum)
+			throw Exception("Invalid hash section.");
+
+		nbucket = words[0];
+		nchain = words[1];
+		bucket = words + 2;
+		chain = bucket + nbucket;
+		hash_type = nbucket ? HashType::SysV : HashType::None;
+	} else if (hdr.type == SHT_GNU_HASH) {
+		if (count < 4 || count - 4 < size_t(words[0]) + words[2] || words[1] > symnum)
+			throw Exception("Invalid hash section.");
+
+		nbucket = words[0];
+		symoffset = words[1];
+		bloom_size = words[2];
+		bloom_shift = words[3];
+		bloom = words + 4;
+		bucket = bloom + bloom_size;
+		chain = bucket + nbucket;
+		// Chain covers symbols from symoffset to the end of the symbol table
+		nchain = static_cast<uint32_t>(std::min(count - 4 - bloom_size - nbucket, symnum - symoffset));
+		hash_type = (nbucket && bloom_size) ? HashType::Gnu : HashType::None;
+	} else {
+		throw Exception("Not a hash section.");
+	}
+
+	hash = table;
+}
+
+const NameIndex &SymbolTable::name_index() const {
+	if (index_guard.ready.load(std::memory_order_acquire))
+		return index;
+
+	std::lock_guard<std::mutex> guard(index_guard.lock);
+	if (!index_guard.ready.load(std::memory_order_relaxed)) {
+		auto syms = symbols();
+		std::pmr::vector<std::string_view> names(index.resource());
+		names.reserve(syms.size());
+
+		for (const Elf32_Sym &sym : syms)
+			names.push_back(strings.get(sym.name));
+
+		index.build(std::move(names));
+		index_guard.ready.store(true, std::memory_order_release);
+	}
+
+	return index;
+}
+
+// Layout: symbol count, name lengths, NameIndex::save() data
+void SymbolTable::save_index(std::vector<uint32_t> &out) const {
+	const NameIndex &names = name_index();
+	auto syms = symbols();
+
+	out.push_back(static_cast<uint32_t>(syms.size()));
+	for (const Elf32_Sym &sym : syms)
+		out.push_back(static_cast<uint32_t>(strings.get(sym.name).size()));
+
+	names.save(out);
+}
+
+void SymbolTable::load_index(std::span<const uint32_t> data) {
+	auto syms = symbols();
+	const char *base = reinterpret_cast<const char*>(strings.data().data());
+	const size_t size = strings.data().size();
+
+	if (data.empty() || data[0] != syms.size() || data.size() < 1 + syms.size())
+		throw Exception("Invalid name index.");
+
+	std::pmr::vector<std::string_view> names(index.resource());
+	names.reserve(syms.size());
+
+	// Only the terminator is checked, the table is the one the index was built from
+	for (size_t idx = 0; idx < syms.size(); idx++) {
+		const size_t offset = syms[idx].name;
+		const size_t length = data[1 + idx];
+
+		if (offset >= size || length >= size - offset || base[offset + length])
+			throw Exception("Invalid name index.");
+
+		names.emplace_back(base + offset, length);
+	}
+
+	index.load(std::move(names), data.subspan(1 + syms.size()));
+	index_guard.ready = true;
+}
+
+bool SymbolTable::is_named(uint32_t idx, std::string_view name) const {
+	auto syms = symbols();
+	return idx < syms.size() && strings.get(syms[idx].name) == name;
+}
+
+// Call func for each symbol index with the given name until it returns true
+template <typename F>
+void SymbolTable::for_each_named(std::string_view name, F func) const {
+	if (!strings.data().data())
+		throw Exception("Symbol table is not linked with a string table.");
+
+	switch (hash_type) {
+		case HashType::SysV: {
+			// A chain visits each symbol at most once, a longer walk is a loop in a damaged table
+			uint32_t steps = 0;
+			for (uint32_t idx = bucket[elf_hash(name) % nbucket]; idx != STN_UNDEF && idx < nchain &&
+			     steps < nchain; idx = chain[idx], steps++)
+				if (is_named(idx, name) && func(idx))
+					return;
+			break;
+		}
+
+		case HashType::Gnu: {
+			const uint32_t h = NameIndex::hash(name);
+			const uint32_t word = bloom[(h / 32) % bloom_size];
+			const uint32_t mask = (1u << (h % 32)) | (1u << ((h >> bloom_shift) % 32));
+
+			// Bloom filter rejects most of absent names without touching the buckets
+			if ((word & mask) != mask)
+				return;
+
+			for (uint32_t idx = bucket[h % nbucket]; idx >= symoffset && idx - symoffset < nchain; idx++) {
+				const uint32_t h2 = chain[idx - symoffset];
+
+				if ((h | 1) == (h2 | 1) && is_named(idx, name) && func(idx))
+					return;
+
+				// Last entry of the chain
+				if (h2 & 1)
+					break;
+			}
+			break;
+		}
+
+		default: {
+			const NameIndex &names = name_index();
+
+			for (uint32_t idx = names.find(name); idx != NameIndex::npos; idx = names.next(idx))
+				if (func(idx))
+					return;
+			break;
+		}
+	}
+}
+
+const Elf32_Sym *SymbolTable::find(std::string_view name) const {
+	auto syms = symbols();
+	const Elf32_Sym *first = nullptr;
+	const Elf32_Sym *found = nullptr;
+
+	for_each_named(name, [&](uint32_t idx) {
+		const Elf32_Sym &sym = syms[idx];
+
+		if (ELF32_ST_BIND(sym.info) != STB_LOCAL && sym.shndx != SHN_UNDEF) {
+			found = &sym;
+			return true;
+		}
+
+		if (!first)
+			first = &sym;
+
+		return false;
+	});
+
+	return found ? found : first;
+}
+
+uint32_t SymbolTable::get(std::string_view name) const {
+	const Elf32_Sym *sym = find(name);
+	if (!sym)
+		throw Exception("Symbol not found");
+
+	return sym->value;
+}
+
+std::vector<const Elf32_Sym*> SymbolTable::get_all(std::string_view name) const {
+	auto syms = symbols();
+	std::vector<const Elf32_Sym*> result;
+
+	for_each_named(name, [&](uint32_t idx) {
+		result.push_back(&syms[idx]);
+		return false;
+	});
+
+	return result;
 }
 
 void SymbolTable::print(const StringsTable* str) {
-	const Elf32_Sym *sym = reinterpret_cast<Elf32_Sym *>(buffer.get());
+	const Elf32_Sym *sym = reinterpret_cast<const Elf32_Sym *>(buffer.get());
 	const Elf32_Sym *end = sym + header.size / sizeof(*sym);
 
+	if (!str && strings.data().data())
+		str = &strings;
+
 	printf("name      value     size info other shndx\n");
 
 	while (sym < end) {
 		printf("%4u 0x%08X %8u %4u %5u %5u ", 
 		       sym->name, sym->value, sym->size, sym->info, sym->other, sym->shndx);
 		if (str)
-			printf("%s", str->get(sym->name).c_str());
+			printf("%s", str->get(sym->name).data());
 		printf("\n");
 		sym++;
 	}
@@ -142,6 +425,7 @@ void sh_flags(int type) {
 	X(SHF_OS_NONCONFORMING); /* OS-specific processing required. */
 	X(SHF_GROUP); /* Member of section group. */
 	X(SHF_TLS); /* Section contains TLS data. */
+	X(SHF_COMPRESSED); /* Section contains compressed data. */
 	X(SHF_MASKOS); /* OS-specific semantics. */
 	X(SHF_MASKPROC); /* Processor-specific semantics. */
 	printf("\n");
@@ -170,126 +454,467 @@ void ph_flags(int type) {
 #undef X
 }
 
-Elf::Elf(std::filesystem::path path)
-	: file(path, std::ios::binary)
+Elf::Elf(std::filesystem::path path, Access access)
+	: arena(access == Access::Arena ? std::make_shared<Arena>(true) : nullptr),
+	  section_index(arena ? arena.get() : std::pmr::get_default_resource())
 {
-	if (!file.is_open())
-		throw String(_T("File open error."));
+	open(path, access);
 
-	file.seekg(0, std::ios_base::end);
-	file_size = file.tellg();
+	std::byte header[sizeof(Elf64_Ehdr)];
+	const size_t length = static_cast<size_t>(std::min<uint64_t>(sizeof(header), file_size));
+	read(header, 0, length);
+	parse_header({ header, length });
 
-	read_header();
-	read_sections();
+	std::vector<unsigned char> storage;
+	{
+		ELF_STATS_TIME(read_sections);
+		parse_sections(read_table(storage, section_table()));
+	}
 
 	update_section_names();
 
-	read_programs();
+	{
+		ELF_STATS_TIME(read_programs);
+		parse_programs(read_table(storage, program_table()));
+	}
+}
+
+// The headers are parsed by ElfLoader as their reads complete
+Elf::Elf(const std::filesystem::path &path, Access access, Deferred)
+	: arena(access == Access::Arena ? std::make_shared<Arena>(true) : nullptr),
+	  section_index(arena ? arena.get() : std::pmr::get_default_resource())
+{
+	open(path, access);
+}
+
+// Headers are validated again, a damaged cache entry must not pass as the file. Only the
+// section names are read.
+Elf::Elf(std::filesystem::path path, Access access, const Snapshot &snapshot)
+	: arena(access == Access::Arena ? std::make_shared<Arena>(true) : nullptr),
+	  section_index(arena ? arena.get() : std::pmr::get_default_resource())
+{
+	open(path, access);
+
+	file_header = snapshot.header;
+
+	if (file_header.shnum != snapshot.sections.size() || file_header.phnum != snapshot.programs.size())
+		throw Exception("Invalid snapshot.");
+
+	try {
+		check_ident(file_header.ident);
+		dispatch([&]<typename Traits>() {
+			check_header<Traits>();
+		});
+
+		sections.reserve(snapshot.sections.size());
+		for (const Elf64_Shdr &hdr : snapshot.sections)
+			sections.emplace_back(hdr, file_size);
+
+		for (const Elf64_Phdr &hdr : snapshot.programs)
+			check_program(hdr);
+	} catch (...) {
+		throw Exception("Invalid snapshot.");
+	}
+
+	programs.assign(snapshot.programs.begin(), snapshot.programs.end());
+
+	update_section_names(snapshot.section_index);
+}
+
+void Elf::open(const std::filesystem::path &path, Access access) {
+	if (access == Access::Mapped) {
+		mapping = std::make_shared<const MappedFile>(path);
+		file_size = mapping->size();
+	} else {
+		file = std::make_unique<const PositionalFile>(path);
+		file_size = file->size();
+	}
+
+	// Arena memory is not reclaimed, evicted sections would be read again into new buffers
+	if (arena)
+		cache.set_budget(SIZE_MAX);
 }
 
+template <typename F>
+void Elf::dispatch(F &&func) {
+	with_traits(file_header.ident, std::forward<F>(func));
+}
 
+void Elf::read(void* buf, std::streamoff offset, std::streamsize size) {
+	if (mapping) {
+		if (offset < 0 || size < 0 || offset + size > file_size)
+			throw String(_T("File read error."));
 
-void Elf::read(void* buf, std::streamsize size) {
-	file.read(static_cast<char*>(buf), size);
+		std::memcpy(buf, mapping->data().data() + offset, size);
+		ELF_STATS_ADD(read_calls, 1);
+		ELF_STATS_ADD(bytes_read, size);
+		return;
+	}
 
-	if (file.fail())
+	if (offset < 0 || size < 0 || offset + size > file_size)
 		throw String(_T("File read error."));
+
+	file->read(buf, size, offset);
+	ELF_STATS_ADD(read_calls, 1);
+	ELF_STATS_ADD(bytes_read, size);
 }
 
-void Elf::read_header() {
-	// ELFMAG ELFCLASS32 ELFDATA2LSB EV_CURRENT
-	constexpr const char supported_header[] = "\177ELF\x01\x01\x01";
+void Elf::read(std::span<const std::span<std::byte>> buffers, std::streamoff offset) {
+	std::streamsize size = 0;
 
-	file.seekg(0, std::ios_base::beg);
+	for (const std::span<std::byte> &buffer : buffers)
+		size += buffer.size();
 
-	// Read file header
-	read(&file_header, sizeof(file_header));
-	if (std::strncmp(reinterpret_cast<const char*>(file_header.ident), supported_header, sizeof(supported_header) - 1))
-		throw Exception("Unsupported elf file.");
+	if (offset < 0 || offset + size > file_size)
+		throw String(_T("File read error."));
+
+	if (mapping) {
+		for (const std::span<std::byte> &buffer : buffers) {
+			std::memcpy(buffer.data(), mapping->data().data() + offset, buffer.size());
+			offset += buffer.size();
+		}
+	} else {
+		file->read(buffers, offset);
+	}
+
+	ELF_STATS_ADD(read_calls, 1);
+	ELF_STATS_ADD(bytes_read, size);
+}
+
+// Identification selects the class and byte order used for the rest of the file
+void Elf::parse_header(std::span<const std::byte> data) {
+	ELF_STATS_TIME(read_header);
+
+	if (data.size() < EI_NIDENT)
+		throw String(_T("File read error."));
+
+	std::memcpy(file_header.ident, data.data(), EI_NIDENT);
+	check_ident(file_header.ident);
+
+	dispatch([&]<typename Traits>() {
+		typename Traits::Ehdr hdr;
+
+		if (data.size() < sizeof(hdr))
+			throw String(_T("File read error."));
+
+		std::memcpy(&hdr, data.data(), sizeof(hdr));
+		read_header<Traits>(hdr);
+	});
+}
+
+void Elf::parse_sections(const unsigned char *table) {
+	dispatch([&]<typename Traits>() {
+		read_sections<Traits>(table);
+	});
+}
 
+void Elf::parse_programs(const unsigned char *table) {
+	dispatch([&]<typename Traits>() {
+		read_programs<Traits>(table);
+	});
+}
+
+template <typename Traits>
+void Elf::read_header(const typename Traits::Ehdr &hdr) {
+	file_header = to_host<Traits>(hdr);
+	check_header<Traits>();
+}
+
+// File header in host form against the file size
+template <typename Traits>
+void Elf::check_header() const {
 	if (file_header.version != EV_CURRENT)
 		throw Exception("Unsupported file version.");
 
-	if (file_header.ehsize < sizeof(Elf32_Ehdr))
+	if (file_header.ehsize < sizeof(typename Traits::Ehdr))
 		throw Exception("Invalid file header size.");
 
-	if (file_header.phoff >= file_size)
+	if (file_header.phoff >= uint64_t(file_size))
 		throw Exception("Invalid program header file offset.");
 
-	if (file_header.phentsize < sizeof(Elf32_Phdr))
+	if (file_header.phnum && file_header.phentsize < sizeof(typename Traits::Phdr))
 		throw Exception("Invalid program header size.");
 
-	if (file_header.phoff + file_header.phnum * sizeof(Elf32_Phdr) > file_size)
+	if (file_header.phoff + table_size(file_header.phnum, file_header.phentsize, sizeof(typename Traits::Phdr)) > uint64_t(file_size))
 		throw Exception("Invalid number of program header entries"); //off + count*size
 
-	if (file_header.shoff >= file_size)
+	if (file_header.shoff >= uint64_t(file_size))
 		throw Exception("Invalid section header file offset.");
 
-	if (file_header.shentsize < sizeof(Elf32_Shdr))
+	if (file_header.shentsize < sizeof(typename Traits::Shdr))
 		throw Exception("Invalid section header size.");
 
-	if (file_header.shoff + file_header.shnum * sizeof(Elf32_Shdr) > file_size)
+	if (file_header.shoff + table_size(file_header.shnum, file_header.shentsize, sizeof(typename Traits::Shdr)) > uint64_t(file_size))
 		throw Exception("Invalid number of section header entries");
 
 	if (file_header.shstrndx >= file_header.shnum)
 		throw Exception("Invalid section name strings section index.");
 }
 
-void Elf::read_programs() {
-	programs.resize(file_header.phnum);
+// Size of a table with count entries spaced by entsize bytes. The last entry may be shorter.
+size_t Elf::table_size(size_t count, size_t entsize, size_t size) {
+	return count ? (count - 1) * entsize + size : 0;
+}
 
-	off_t pos = file_header.phoff;
-	for (auto idx = 0; idx < file_header.phnum; idx++) {
-		file.seekg(pos, std::ios_base::beg);
+// File offset and length of the section header table
+std::pair<uint64_t, size_t> Elf::section_table() const {
+	const size_t size = get_class() == ELFCLASS32 ? sizeof(Elf32_Shdr) : sizeof(Elf64_Shdr);
+	return { file_header.shoff, table_size(file_header.shnum, file_header.shentsize, size) };
+}
 
-		read(&programs[idx], sizeof(programs[0]));
+std::pair<uint64_t, size_t> Elf::program_table() const {
+	const size_t size = get_class() == ELFCLASS32 ? sizeof(Elf32_Phdr) : sizeof(Elf64_Phdr);
+	return { file_header.phoff, table_size(file_header.phnum, file_header.phentsize, size) };
+}
 
-		if ((programs[idx].filesz > programs[idx].memsz) ||
-			(programs[idx].off && programs[idx].filesz && (programs[idx].off + programs[idx].filesz > file_size)))
-			throw Exception("Invalid program header.");
+// Read the whole table in a single transfer. A mapped file is accessed in place.
+const unsigned char *Elf::read_table(std::vector<unsigned char> &storage, std::pair<uint64_t, size_t> table) {
+	const auto [offset, length] = table;
 
-		pos += file_header.phentsize;
+	if (mapping) {
+		if (offset + length > uint64_t(file_size))
+			throw String(_T("File read error."));
+
+		return reinterpret_cast<const unsigned char*>(mapping->data().data()) + offset;
 	}
+
+	storage.resize(length);
+	ELF_STATS_ADD(allocations, 1);
+	ELF_STATS_ADD(bytes_allocated, length);
+	read(storage.data(), offset, length);
+	return storage.data();
 }
 
-void Elf::read_sections() {
+template <typename Traits>
+void Elf::read_programs(const unsigned char *table) {
+	programs.resize(file_header.phnum);
+
+	for (auto idx = 0; idx < file_header.phnum; idx++) {
+		typename Traits::Phdr hdr;
+		std::memcpy(&hdr, table, sizeof(hdr));
+		programs[idx] = to_host<Traits>(hdr);
+		check_program(programs[idx]);
+
+		table += file_header.phentsize;
+	}
+}
+
+void Elf::check_program(const Elf64_Phdr &hdr) const {
+	if ((hdr.filesz > hdr.memsz) ||
+		(hdr.off && hdr.filesz && (hdr.filesz > uint64_t(file_size) || hdr.off > file_size - hdr.filesz)))
+		throw Exception("Invalid program header.");
+}
+
+template <typename Traits>
+void Elf::read_sections(const unsigned char *table) {
 	sections.reserve(file_header.shnum);
 
-	off_t pos = file_header.shoff;
 	for (auto idx = 0; idx < file_header.shnum; idx++) {
-		file.seekg(pos, std::ios_base::beg);
+		typename Traits::Shdr hdr;
+		std::memcpy(&hdr, table, sizeof(hdr));
 
-		sections.emplace_back(&file, file_size);
+		sections.emplace_back(to_host<Traits>(hdr), file_size);
 
-		pos += file_header.shentsize;
+		table += file_header.shentsize;
 	}
 }
 
-void Elf::update_section_names() {
-	StringsTable strings;
+// The name index is loaded from cached data when given, otherwise it is built
+void Elf::update_section_names(std::span<const uint32_t> cached) {
+	ELF_STATS_TIME(update_section_names);
+	read_section(section_names, file_header.shstrndx);
+	index_section_names(cached);
+}
+
+// Section names are already read
+void Elf::index_section_names(std::span<const uint32_t> cached) {
+	std::pmr::vector<std::string_view> names(section_index.resource());
+	names.reserve(sections.size());
 
-	read_section(strings, file_header.shstrndx);
+	for (size_t idx = 0; idx < sections.size(); idx++) {
+		sections[idx].update_name(section_names);
+		names.push_back(sections[idx].name_str);
+	}
 
-	for (auto idx = 0; idx < sections.size(); idx++)
-		sections[idx].update_name(strings);
+	if (cached.empty())
+		section_index.build(std::move(names));
+	else
+		section_index.load(std::move(names), cached);
 }
 
-int Elf::find_section(const std::string name) {
-	for (auto idx = 0; idx < sections.size(); idx++)
-		if (sections[idx].name_str == name)
-			return idx;
+int Elf::find_section(std::string_view name) const {
+	uint32_t idx = section_index.find(name);
 
-	return -1;
+	return idx != NameIndex::npos ? static_cast<int>(idx) : -1;
 }
 
 void Elf::read_section(Section& section, unsigned int index) {
+	ELF_STATS_TIME(read_section);
+
 	if (index >= sections.size())
 		throw String(_T("Invalid section index."));
 
-	section.read(&file, &sections[index], file_size);
+	const bool compressed = sections[index].flags & SHF_COMPRESSED;
+
+	// Mapped sections are not copied, there is nothing to cache
+	if (mapping && !compressed) {
+		section.read(mapping, &sections[index]);
+		return;
+	}
+
+	SectionCache::Buffer buffer = cache.get(index);
+	if (buffer) {
+		section.header = compressed ? decompressed_header(index) : sections[index];
+		section.buffer = buffer;
+		return;
+	}
+
+	if (compressed) {
+		decompress_section(section, index);
+	} else {
+		section.read(*file, &sections[index], arena);
+		ELF_STATS_ADD(read_calls, 1);
+		ELF_STATS_ADD(bytes_read, section.header.size);
+	}
+
+	cache.put(index, section.buffer, section.header.size);
+	ELF_STATS_ADD(allocations, 1);
+	ELF_STATS_ADD(bytes_allocated, section.header.size);
+}
+
+// References to the map elements stay valid, only lookups need the lock
+const Elf64_Chdr &Elf::compression_header(unsigned int index) {
+	{
+		std::lock_guard<std::mutex> guard(compression_lock);
+		auto it = compression.find(index);
+		if (it != compression.end())
+			return it->second;
+	}
+
+	const SectionHeader &hdr = sections[index];
+	if (hdr.type == SHT_NOBITS)
+		throw Exception("Cannot read SHT_NOBITS section.");
+
+	Elf64_Chdr chdr;
+	dispatch([&]<typename Traits>() {
+		typename Traits::Chdr raw;
+
+		if (hdr.size < sizeof(raw))
+			throw Exception("Invalid compressed section.");
+
+		read(&raw, hdr.off, sizeof(raw));
+		chdr = to_host<Traits>(raw);
+	});
+
+	std::lock_guard<std::mutex> guard(compression_lock);
+	return compression.emplace(index, chdr).first->second;
 }
 
-void Elf::read_section(Section &section, const std::string name) {
+SectionHeader Elf::decompressed_header(unsigned int index) {
+	const Elf64_Chdr &chdr = compression_header(index);
+	SectionHeader header = sections[index];
+
+	header.flags &= ~SHF_COMPRESSED;
+	header.size = chdr.size;
+	header.addralign = chdr.addralign;
+	return header;
+}
+
+static size_t chdr_size(unsigned char elf_class) {
+	return elf_class == ELFCLASS32 ? sizeof(Elf32_Chdr) : sizeof(Elf64_Chdr);
+}
+
+template <typename F>
+void Elf::for_each_chunk(const SectionHeader &header, uint64_t skip, size_t chunk_size, F &&func) {
+	if (header.type == SHT_NOBITS)
+		throw Exception("Cannot read SHT_NOBITS section.");
+
+	const uint64_t end = header.off + header.size;
+	std::vector<std::byte> chunk;
+
+	chunk_size = std::max<size_t>(chunk_size, 1);
+	if (!mapping)
+		chunk.resize(std::min<uint64_t>(chunk_size, header.size - skip));
+
+	for (uint64_t pos = header.off + skip; pos < end; pos += chunk_size) {
+		const size_t length = static_cast<size_t>(std::min<uint64_t>(chunk_size, end - pos));
+
+		if (mapping) {
+			func(mapping->data().subspan(pos, length));
+		} else {
+			read(chunk.data(), pos, length);
+			func(std::span<const std::byte>(chunk.data(), length));
+		}
+	}
+}
+
+// Decode straight into the section buffer, the compressed data is read in chunks
+void Elf::decompress_section(Section &section, unsigned int index) {
+	const Elf64_Chdr &chdr = compression_header(index);
+	Decompressor decompressor(chdr.type);
+
+	section.header = decompressed_header(index);
+	unsigned char *data = section.allocate(chdr.size, arena);
+	std::span<std::byte> output(reinterpret_cast<std::byte*>(data), chdr.size);
+	bool done = false;
+
+	for_each_chunk(sections[index], chdr_size(get_class()), default_chunk_size,
+		       [&](std::span<const std::byte> input) {
+		if (!done)
+			done = decompressor.run(input, output);
+
+		if (!done && !input.empty())
+			throw Exception("Compressed section size mismatch.");
+	});
+
+	if (!done || !output.empty())
+		throw Exception("Compressed section size mismatch.");
+}
+
+void Elf::stream_section(unsigned int index, const ChunkHandler &handler, size_t chunk_size) {
+	if (index >= sections.size())
+		throw String(_T("Invalid section index."));
+
+	const SectionHeader &hdr = sections[index];
+	if (!(hdr.flags & SHF_COMPRESSED)) {
+		for_each_chunk(hdr, 0, chunk_size, handler);
+		return;
+	}
+
+	const Elf64_Chdr &chdr = compression_header(index);
+	Decompressor decompressor(chdr.type);
+	std::vector<std::byte> chunk(std::max<size_t>(std::min<uint64_t>(chunk_size, chdr.size), 1));
+	uint64_t total = 0;
+	bool done = false;
+
+	for_each_chunk(hdr, chdr_size(get_class()), chunk_size, [&](std::span<const std::byte> input) {
+		// Drain the output until the decoder needs more input
+		while (!done) {
+			std::span<std::byte> output(chunk);
+			done = decompressor.run(input, output);
+
+			const size_t produced = chunk.size() - output.size();
+			total += produced;
+			if (total > chdr.size)
+				throw Exception("Compressed section size mismatch.");
+
+			if (!produced)
+				break;
+
+			handler(std::span<const std::byte>(chunk.data(), produced));
+		}
+	});
+
+	if (!done || total != chdr.size)
+		throw Exception("Compressed section size mismatch.");
+}
+
+void Elf::set_cache_budget(size_t bytes) {
+	if (!arena)
+		cache.set_budget(bytes);
+}
+
+void Elf::read_section(Section &section, std::string_view name) {
 	int index = find_section(name);
 	if (index < 0)
 		throw Exception("Section not found");
@@ -297,52 +922,212 @@ void Elf::read_section(Section &section, const std::string name) {
 	read_section(section, index);
 }
 
+void Elf::read_symbols(SymbolTable &symbols, unsigned int index) {
+	StringsTable strings;
+	read_section(strings, symbol_strings(index));
+	read_section(symbols, index);
 
+	link_symbols(symbols, index, strings);
+}
 
-#if 0
-// Read firmware image from elf file based on Program headers
+// Index of the string table of a valid symbol table
+unsigned int Elf::symbol_strings(unsigned int index) const {
+	if (index >= sections.size())
+		throw String(_T("Invalid section index."));
+
+	const SectionHeader &hdr = sections[index];
+	if (hdr.type != SHT_SYMTAB && hdr.type != SHT_DYNSYM)
+		throw Exception("Not a symbol table section.");
+
+	if (hdr.link >= sections.size() || sections[hdr.link].type != SHT_STRTAB)
+		throw Exception("Invalid symbol table string section.");
+
+	return hdr.link;
+}
+
+// Convert the symbols read from the section and attach the strings and a hash table
+void Elf::link_symbols(SymbolTable &symbols, unsigned int index, const StringsTable &strings) {
+	bool native = false;
+	dispatch([&]<typename Traits>() {
+		convert_symbols<Traits>(symbols);
+		native = native_symbols<Traits>;
+	});
+
+	symbols.link(strings, arena ? arena.get() : std::pmr::get_default_resource());
+
+	// On-disk hash tables are only used in place with native symbols
+	if (!native)
+		return;
+
+	// Prefer on-disk hash table of this symbol table, GNU one has a bloom filter
+	int hash_index = -1;
+	for (unsigned int idx = 0; idx < sections.size(); idx++) {
+		if (sections[idx].link != index)
+			continue;
+
+		if (sections[idx].type == SHT_GNU_HASH) {
+			hash_index = idx;
+			break;
+		}
+
+		if (sections[idx].type == SHT_HASH)
+			hash_index = idx;
+	}
+
+	if (hash_index >= 0) {
+		Section hash;
+		read_section(hash, hash_index);
+		symbols.attach_hash(hash);
+	}
+}
+
+// Convert symbols to Elf32_Sym in host byte order, native tables are used in place
+template <typename Traits>
+void Elf::convert_symbols(SymbolTable &symbols) {
+	using Sym = typename Traits::Sym;
+
+	if constexpr (!native_symbols<Traits>) {
+		auto raw = symbols.data();
+		const size_t count = raw.size() / sizeof(Sym);
+		std::shared_ptr<Elf32_Sym[]> converted;
+		if (arena)
+			converted = std::shared_ptr<Elf32_Sym[]>(arena, static_cast<Elf32_Sym*>(
+				arena->allocate(count * sizeof(Elf32_Sym), alignof(Elf32_Sym))));
+		else
+			converted.reset(new Elf32_Sym[count]);
+		ELF_STATS_ADD(allocations, 1);
+		ELF_STATS_ADD(bytes_allocated, count * sizeof(Elf32_Sym));
+
+		for (size_t idx = 0; idx < count; idx++) {
+			Sym in;
+			std::memcpy(&in, raw.data() + idx * sizeof(Sym), sizeof(Sym));
+
+			const auto value = Traits::get(in.value);
+			const auto size = Traits::get(in.size);
+			Elf32_Sym &out = converted[idx];
+			if (value > UINT32_MAX || size > UINT32_MAX) {
+				// A null entry keeps the indices of the other symbols
+				out = {};
+				continue;
+			}
+
+			out.name = Traits::get(in.name);
+			out.value = static_cast<Elf32_Addr>(value);
+			out.size = static_cast<Elf32_Word>(size);
+			out.info = in.info;
+			out.other = in.other;
+			out.shndx = Traits::get(in.shndx);
+		}
+
+		symbols.header.size = count * sizeof(Elf32_Sym);
+		symbols.header.entsize = sizeof(Elf32_Sym);
+		symbols.buffer = std::shared_ptr<const unsigned char[]>(converted,
+			reinterpret_cast<const unsigned char*>(converted.get()));
+	}
+}
+
+void Elf::read_symbols(SymbolTable &symbols, std::string_view name) {
+	int index = find_section(name);
+	if (index < 0)
+		throw Exception("Section not found");
+
+	read_symbols(symbols, index);
+}
+
+
+
+// Read firmware image from elf file based on Program headers. Segments are read in
+// file order, segments following each other in the file are read at once.
 void Elf::read_image(ImageInterface& image) {
-	for (const Elf32_Phdr &hdr : programs) {
+	std::vector<const Elf64_Phdr*> loads;
+
+	for (const Elf64_Phdr &hdr : programs) {
 		// Use only load headers with content in file
 		if ((hdr.type != PT_LOAD) || !hdr.filesz)
 			continue;
 
-		auto buf = image.process(hdr.paddr, hdr.memsz);
-		file.seekg(hdr.off, std::ios_base::beg);
-		read(buf.data(), hdr.filesz);
+		loads.push_back(&hdr);
+	}
+
+	std::sort(loads.begin(), loads.end(), [](const Elf64_Phdr *a, const Elf64_Phdr *b) {
+		return a->off < b->off;
+	});
+
+	std::vector<std::span<std::byte>> targets;
+	std::vector<std::span<std::byte>> buffers;
+
+	for (size_t idx = 0; idx < loads.size();) {
+		const size_t start = idx;
+		const uint64_t offset = loads[idx]->off;
+		uint64_t end = offset;
+
+		// The file content of a run is scattered to the segments by a single vectored read
+		targets.clear();
+		buffers.clear();
+		for (; idx < loads.size() && loads[idx]->off == end; idx++) {
+			targets.push_back(image.process(loads[idx]->paddr, loads[idx]->memsz));
+			buffers.push_back(targets.back().first(loads[idx]->filesz));
+			end += loads[idx]->filesz;
+		}
+
+		read(buffers, offset);
 
-		//printf("0x%0X - 0x%0X; 0x%0X bytes (0x%0X in from file)\n",
-		//	   hdr.paddr, hdr.paddr + hdr.memsz - 1, hdr.memsz, hdr.filesz);
+		for (size_t seg = start; seg < idx; seg++) {
+			const std::span<std::byte> target = targets[seg - start];
+			std::memset(target.data() + loads[seg]->filesz, 0, loads[seg]->memsz - loads[seg]->filesz);
+			image.complete(loads[seg]->paddr, target);
+		}
 	}
 }
 
-// Read firmware image from elf file based on Section headers
-void Elf::read_image2(ImageInterface& image) {
-	for (const Elf32_Shdr& hdr : sections) {
-		// Use only load headers with content in file
-		if (hdr.type != SHT_PROGBITS)
+// Physical address range covering all loadable segments
+std::pair<uint64_t, uint64_t> Elf::image_bounds() const {
+	uint64_t begin = UINT64_MAX;
+	uint64_t end = 0;
+
+	for (const Elf64_Phdr &hdr : programs) {
+		if ((hdr.type != PT_LOAD) || !hdr.filesz)
 			continue;
 
-		assert(hdr.flags & SHF_ALLOC);
+		begin = std::min(begin, hdr.paddr);
+		end = std::max(end, hdr.paddr + hdr.memsz);
+	}
 
-		auto buf = image.process(hdr.vaddr, hdr.size);
-		file.seekg(hdr.off, std::ios_base::beg);
-		read(buf.data(), hdr.size);
+	if (begin > end)
+		throw Exception("No loadable segments.");
 
-		//printf("0x%0X - 0x%0X; 0x%0X bytes (%s)\n",
-		//	hdr.vaddr, hdr.vaddr + hdr.size - 1, hdr.size, strings.get(hdr.name).c_str());
-	}
+	return { begin, end };
+}
+
+Image Elf::read_image(std::byte fill) {
+	const auto [begin, end] = image_bounds();
+
+	Image image(begin, end - begin);
+	read_image(image);
+	image.fill_gaps(fill);
+
+	return image;
+}
+
+std::unique_ptr<HashedImage> Elf::read_image(ThreadPool &pool, unsigned int algorithms, std::byte fill) {
+	const auto [begin, end] = image_bounds();
+
+	auto image = std::make_unique<HashedImage>(begin, end - begin, pool, algorithms);
+	read_image(*image);
+	image->fill_gaps(fill);
+	image->finish();
+
+	return image;
 }
-#endif
 
 void Elf::print() {
 	printf("File type: 0x%04x ", file_header.type);
 	e_type(file_header.type);
 	printf("Machine architecture: 0x%04x\n", file_header.machine);
 	printf("ELF format version: 0x%08x\n", file_header.version);
-	printf("Entry point: 0x%08x\n", file_header.entry);
-	printf("Program header file offset: 0x%08x\n", file_header.phoff);
-	printf("Section header file offset: 0x%08x\n", file_header.shoff);
+	printf("Entry point: 0x%08" PRIx64 "\n", file_header.entry);
+	printf("Program header file offset: 0x%08" PRIx64 "\n", file_header.phoff);
+	printf("Section header file offset: 0x%08" PRIx64 "\n", file_header.shoff);
 	printf("Architecture-specific flags: 0x%08x\n", file_header.flags);
 	printf("Size of ELF header in bytes: 0x%04x\n", file_header.ehsize);
 	printf("Size of program header entry: 0x%04x\n", file_header.phentsize);
@@ -353,19 +1138,20 @@ void Elf::print() {
 
 	for (auto idx = 0; idx < file_header.shnum; idx++) {
 		SectionHeader& sect = sections[idx];
-		printf("\nSection %u (%s [%u])\n", idx, sect.name_str.c_str(), sect.name);
+		printf("\nSection %u (%.*s [%u])\n", idx, static_cast<int>(sect.name_str.size()),
+		       sect.name_str.data(), sect.name);
 		printf("\tSection name index: 0x%04x\n", sect.name);
 		printf("\tSection type: 0x%04x ", sect.type);
 		sh_type(sect.type);
-		printf("\tSection flags: 0x%04x\n", sect.flags);
+		printf("\tSection flags: 0x%04" PRIx64 "\n", sect.flags);
 		sh_flags(sect.flags);
-		printf("\tAddress in memory image: 0x%04x\n", sect.vaddr);
-		printf("\tOffset in file: 0x%04x\n", sect.off);
-		printf("\tSize in bytes: 0x%04x\n", sect.size);
+		printf("\tAddress in memory image: 0x%04" PRIx64 "\n", sect.addr);
+		printf("\tOffset in file: 0x%04" PRIx64 "\n", sect.off);
+		printf("\tSize in bytes: 0x%04" PRIx64 "\n", sect.size);
 		printf("\tIndex of a related section: 0x%04x\n", sect.link);
 		printf("\tDepends on section type: 0x%04x\n", sect.info);
-		printf("\tAlignment in bytes: 0x%04x\n", sect.addralign);
-		printf("\tSize of each entry in section: 0x%04x\n", sect.entsize);
+		printf("\tAlignment in bytes: 0x%04" PRIx64 "\n", sect.addralign);
+		printf("\tSize of each entry in section: 0x%04" PRIx64 "\n", sect.entsize);
 #if 0
 		if (sect.type == SHT_STRTAB) {
 			StringSection str;
@@ -376,27 +1162,27 @@ void Elf::print() {
 	}
 
 	for (auto idx = 0; idx < file_header.phnum; idx++) {
-		Elf32_Phdr& prog = programs[idx];
+		Elf64_Phdr& prog = programs[idx];
 
 		// TODO: Program header validation
 		printf("\nProgram header %d:\n", idx);
 		printf("\tEntry type: 0x%0x\n", prog.type);
 		ph_type(prog.type);
-		printf("\tFile offset of contents: 0x%0x\n", prog.off);
-		printf("\tVirtual address in memory image: 0x%0x\n", prog.vaddr);
-		printf("\tPhysical address (not used): 0x%0x\n", prog.paddr);
-		printf("\tSize of contents in file: 0x%0x\n", prog.filesz);
-		printf("\tSize of contents in memory: 0x%0x\n", prog.memsz);
+		printf("\tFile offset of contents: 0x%" PRIx64 "\n", prog.off);
+		printf("\tVirtual address in memory image: 0x%" PRIx64 "\n", prog.vaddr);
+		printf("\tPhysical address (not used): 0x%" PRIx64 "\n", prog.paddr);
+		printf("\tSize of contents in file: 0x%" PRIx64 "\n", prog.filesz);
+		printf("\tSize of contents in memory: 0x%" PRIx64 "\n", prog.memsz);
 		printf("\tAccess permission flags: 0x%0x\n", prog.flags);
 		ph_flags(prog.flags);
-		printf("\tAlignment in memory and file: 0x%0x\n", prog.align);
+		printf("\tAlignment in memory and file: 0x%" PRIx64 "\n", prog.align);
 
 		if (!(prog.off && prog.filesz)) {
 			if (prog.off)
-				printf("Warning! Non zero file offset (%u) when filesz = 0.\n", prog.off);
+				printf("Warning! Non zero file offset (%" PRIu64 ") when filesz = 0.\n", prog.off);
 
 			if (prog.filesz)
-				printf("Warning! Non zero file size (%u) when offset = 0.\n", prog.filesz);
+				printf("Warning! Non zero file size (%" PRIu64 ") when offset = 0.\n", prog.filesz);
 		}
 	}
 }
@@ -8,70 +8,279 @@
 #ifndef __ELF_HPP__
 #define __ELF_HPP__
 
+#include <atomic>
 #include <fstream>
 #include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "elf.h"
+#include "Arena.hpp"
+#include "MappedFile.hpp"
+#include "PositionalFile.hpp"
+#include "NameIndex.hpp"
+#include "SectionCache.hpp"
+#include "ElfStats.hpp"
 
 
 namespace elf {
 	class StringsTable;
+	class ImageInterface;
+	class Image;
+	class HashedImage;
+	class ThreadPool;
 
-	class SectionHeader : public Elf32_Shdr {
+	// Section header in host byte order, ELF32 headers are widened
+	class SectionHeader : public Elf64_Shdr {
 		public:
 			SectionHeader();
-			SectionHeader(std::istream* stream, std::streamsize file_size = 0);
+			SectionHeader(const Elf64_Shdr &hdr, std::streamsize file_size = 0);
 
 			void update_name(const StringsTable &str);
 			
-			std::string name_str;
+			// Points into the section name strings table retained by Elf
+			std::string_view name_str;
 	};
 
 	class Section {
 		public:
+			// The buffer is allocated from the arena if one is given
 			void read(std::istream* stream, const SectionHeader* header,
-				  std::streamsize file_size = 0);
+				  std::streamsize file_size = 0, const std::shared_ptr<Arena> &arena = nullptr);
+			void read(const PositionalFile &file, const SectionHeader* header,
+				  const std::shared_ptr<Arena> &arena = nullptr);
+			void read(const std::shared_ptr<const MappedFile> &file,
+				  const SectionHeader* header);
+
+			// Section content, points into the file mapping in Access::Mapped mode
+			std::span<const std::byte> data() const;
+			const SectionHeader &get_header() const { return header; }
 
 		protected:
 			SectionHeader header;
-			std::shared_ptr<unsigned char[]> buffer;
+			std::shared_ptr<const unsigned char[]> buffer;
+
+			// Set a new writable buffer, taken from the arena if one is given
+			unsigned char *allocate(size_t size, const std::shared_ptr<Arena> &arena);
+
+			friend class Elf;
+			friend class ElfStream;
+			friend class AsyncReader;
 	};
 
 	class StringsTable: public Section {
 		public:
-			std::string get(unsigned int index) const;
+			// Bounds checked, the string is NUL terminated within the section
+			std::string_view get(unsigned int index) const;
 			void print();
 	};
 
 	class SymbolTable: public Section {
 		public:
-			uint32_t get(std::string name);
+			// Attach string table with symbol names, required by name lookups. The name
+			// index built for lookups is allocated from the resource.
+			void link(const StringsTable &str,
+				  std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+			// Use on-disk SHT_HASH or SHT_GNU_HASH table of this symbol table for
+			// lookups instead of building an index. Such tables only cover symbols
+			// visible to the dynamic linker.
+			void attach_hash(const Section &table);
+
+			std::span<const Elf32_Sym> symbols() const;
+			const StringsTable &get_strings() const { return strings; }
+
+			// Symbol by name, a defined global symbol is preferred over local ones
+			const Elf32_Sym *find(std::string_view name) const;
+			// Value of the symbol, throws when the symbol is not found
+			uint32_t get(std::string_view name) const;
+			// All symbols with the given name, e.g. local symbols from different files
+			std::vector<const Elf32_Sym*> get_all(std::string_view name) const;
+
 			void print(const StringsTable* str = nullptr);
+
+			// Flat copy of the name index for persistent caches. Name lengths are stored
+			// too, so loading does not scan the string table.
+			void save_index(std::vector<uint32_t> &out) const;
+			void load_index(std::span<const uint32_t> data);
+
+		protected:
+			StringsTable strings;
+
+		private:
+			// Built on the first lookup when there is no on-disk hash table. Concurrent
+			// lookups build it once, copies get their own lock.
+			struct IndexGuard {
+				std::mutex lock;
+				std::atomic<bool> ready = false;
+
+				IndexGuard() = default;
+				IndexGuard(const IndexGuard &other) : ready(other.ready.load()) {}
+				IndexGuard &operator=(const IndexGuard &other) { ready = other.ready.load(); return *this; }
+			};
+
+			mutable NameIndex index;
+			mutable IndexGuard index_guard;
+
+			enum class HashType { None, SysV, Gnu };
+
+			Section hash;
+			HashType hash_type = HashType::None;
+			uint32_t nbucket = 0;
+			uint32_t nchain = 0;
+			uint32_t symoffset = 0;
+			uint32_t bloom_size = 0;
+			uint32_t bloom_shift = 0;
+			const uint32_t *bloom = nullptr;
+			const uint32_t *bucket = nullptr;
+			const uint32_t *chain = nullptr;
+
+			const NameIndex &name_index() const;
+			bool is_named(uint32_t idx, std::string_view name) const;
+
+			template <typename F>
+			void for_each_named(std::string_view name, F func) const;
 	};
 
 	class Elf {
 		public:
-			Elf(std::filesystem::path path);
+			enum class Access {
+				Stream,	// Sections are copied from the file stream
+				Mapped,	// Sections refer directly to the memory mapped file
+				Arena,	// Sections are read once from the stream into an arena freed with the Elf
+			};
+
+			// Receives consecutive parts of a section content
+			using ChunkHandler = std::function<void(std::span<const std::byte> chunk)>;
+
+			static constexpr size_t default_chunk_size = 256 * 1024;
+
+			Elf(std::filesystem::path path, Access access = Access::Stream);
 			void print();
+
+			// Headers of both classes and byte orders are kept as Elf64 structures in host byte order
+			const Elf64_Ehdr &get_file_header() const { return file_header; }
+			unsigned char get_class() const { return file_header.ident[EI_CLASS]; }
+			unsigned char get_byte_order() const { return file_header.ident[EI_DATA]; }
+
+			// Section contents read from the stream are cached up to this many bytes,
+			// in Access::Arena mode all sections are kept
+			void set_cache_budget(size_t bytes);
+			// SHF_COMPRESSED sections are decompressed, the header describes the decompressed content.
+			// Sections may be read by several threads at once.
 			void read_section(Section &section, unsigned int index);
-			void read_section(Section &section, std::string name);
-			int find_section(const std::string name);
+			void read_section(Section &section, std::string_view name);
+			// Pass the section content to the handler in chunks of at most chunk_size bytes.
+			// Compressed sections are decoded on the fly, neither copy is held in memory whole.
+			void stream_section(unsigned int index, const ChunkHandler &handler,
+					    size_t chunk_size = default_chunk_size);
+			int find_section(std::string_view name) const;
+			const std::vector<SectionHeader> &get_sections() const { return sections; }
+			const StringsTable &get_section_names() const { return section_names; }
+			const std::vector<Elf64_Phdr> &get_programs() const { return programs; }
+
+			// Copy PT_LOAD segments into the image, zero filling up to memsz
+			void read_image(ImageInterface &image);
+			// Image spanning all loadable segments, gaps between them are filled
+			Image read_image(std::byte fill = std::byte(0));
+			// The same image with digests of every segment and of the whole image, see
+			// HashedImage. Segments are hashed on the pool while the next ones are read.
+			std::unique_ptr<HashedImage> read_image(ThreadPool &pool, unsigned int algorithms,
+								std::byte fill = std::byte(0));
+
+			// Read symbol table and link it with its string table. Symbols of other
+			// formats than ELF32 in host byte order are converted to Elf32_Sym. Symbols
+			// whose value or size does not fit in 32 bits become null entries.
+			void read_symbols(SymbolTable &symbols, unsigned int index);
+			void read_symbols(SymbolTable &symbols, std::string_view name = ".symtab");
+
+#ifdef ELF_STATS
+			const ElfStats &get_stats() const { return stats; }
+#endif
 
 		protected:
-			std::ifstream file;
+			// Positional reads, there is no shared file position
+			std::unique_ptr<const PositionalFile> file;
+			std::shared_ptr<const MappedFile> mapping;
+			// Section buffers share ownership of the arena, it outlives all of them
+			std::shared_ptr<Arena> arena;
 			std::streamsize file_size;
 			std::vector<SectionHeader> sections;
-			std::vector<Elf32_Phdr> programs;
+			std::vector<Elf64_Phdr> programs;
+			StringsTable section_names;
+			NameIndex section_index;
+			SectionCache cache;
+			// Compression headers of SHF_COMPRESSED sections, read on first use
+			std::unordered_map<unsigned int, Elf64_Chdr> compression;
+			std::mutex compression_lock;
+#ifdef ELF_STATS
+			ElfStats stats;
+#endif
+
+			// Validated headers and the section name index, as stored by ElfCache
+			struct Snapshot {
+				Elf64_Ehdr header;
+				std::span<const Elf64_Shdr> sections;
+				std::span<const Elf64_Phdr> programs;
+				std::span<const uint32_t> section_index;
+			};
+
+			Elf(std::filesystem::path path, Access access, const Snapshot &snapshot);
+
+			struct Deferred {};
+			// Only opens the file, ElfLoader reads and parses the headers
+			Elf(const std::filesystem::path &path, Access access, Deferred);
+
+			friend class ElfCache;
+			friend class AsyncReader;
+			friend class ElfLoader;
 
 		private:
-			Elf32_Ehdr file_header;
+			Elf64_Ehdr file_header;
+
+			void read(void *buf, std::streamoff offset, std::streamsize size);
+			// Consecutive file bytes scattered into the buffers by a single read
+			void read(std::span<const std::span<std::byte>> buffers, std::streamoff offset);
+			const unsigned char *read_table(std::vector<unsigned char> &storage, std::pair<uint64_t, size_t> table);
+			static size_t table_size(size_t count, size_t entsize, size_t size);
+			std::pair<uint64_t, size_t> section_table() const;
+			std::pair<uint64_t, size_t> program_table() const;
+			std::pair<uint64_t, uint64_t> image_bounds() const;
+			void open(const std::filesystem::path &path, Access access);
+			void update_section_names(std::span<const uint32_t> cached = {});
+			void check_program(const Elf64_Phdr &hdr) const;
+
+			// Constructor phases working on data already read
+			void parse_header(std::span<const std::byte> data);
+			void parse_sections(const unsigned char *table);
+			void parse_programs(const unsigned char *table);
+			void index_section_names(std::span<const uint32_t> cached = {});
+
+			unsigned int symbol_strings(unsigned int index) const;
+			void link_symbols(SymbolTable &symbols, unsigned int index, const StringsTable &strings);
+
+			const Elf64_Chdr &compression_header(unsigned int index);
+			SectionHeader decompressed_header(unsigned int index);
+			void decompress_section(Section &section, unsigned int index);
+
+			// Call func for the file content of the section from the given offset, in chunks
+			template <typename F>
+			void for_each_chunk(const SectionHeader &header, uint64_t skip, size_t chunk_size, F &&func);
+
+			// Call func.template operator()<Traits>() for the class and byte order of the file
+			template <typename F>
+			void dispatch(F &&func);
 
-			void read(void *buf, std::streamsize size);
-			void read_header();
-			void read_programs();
-			void read_sections();
-			void update_section_names();
+			template <typename Traits> void read_header(const typename Traits::Ehdr &hdr);
+			template <typename Traits> void check_header() const;
+			template <typename Traits> void read_programs(const unsigned char *table);
+			template <typename Traits> void read_sections(const unsigned char *table);
+			template <typename Traits> void convert_symbols(SymbolTable &symbols);
 	};
 
 };
@@ -0,0 +1,257 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Copyright(c) 2023 Koko Software. All rights reserved.
+//
+// Author: Adrian Warecki <embedded@kokosoftware.pl>
+
+#include "types.hpp"
+#include "ElfCache.hpp"
+#include "MappedFile.hpp"
+
+#include <cinttypes>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace elf;
+
+namespace {
+	// Array stored in the entry, offset is 8 byte aligned
+	struct Block {
+		uint64_t offset;
+		uint64_t count;
+	};
+
+	// Entries are written in host byte order, they are not shared between machines
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t symtab;	// Section index of the symbol table or UINT32_MAX
+		uint64_t file_size;
+		int64_t mtime;
+		uint64_t hash;
+		Elf64_Ehdr header;
+		Block path;
+		Block sections;
+		Block programs;
+		Block section_index;
+		Block symbol_index;
+		Block address_index;
+	};
+
+	const char magic[8] = { 'E', 'L', 'F', 'C', 'A', 'C', 'H', 'E' };
+
+	class Writer {
+		public:
+			Writer() : data(sizeof(Header)) {}
+
+			template <typename T>
+			Block append(std::span<const T> items) {
+				data.resize((data.size() + 7) & ~size_t(7));
+
+				const Block block = { data.size(), items.size() };
+				const auto *bytes = reinterpret_cast<const std::byte*>(items.data());
+				data.insert(data.end(), bytes, bytes + items.size_bytes());
+				return block;
+			}
+
+			std::vector<std::byte> data;
+	};
+
+	template <typename T>
+	std::span<const T> block(const MappedFile &file, const Block &block) {
+		const uint64_t size = file.size();
+
+		if (block.offset % 8 || block.offset > size || block.count > (size - block.offset) / sizeof(T))
+			throw Exception("Invalid cache entry.");
+
+		return { reinterpret_cast<const T*>(file.data().data() + block.offset), static_cast<size_t>(block.count) };
+	}
+}
+
+ElfCache::ElfCache(std::filesystem::path dir)
+	: dir(std::move(dir))
+{
+	std::filesystem::create_directories(this->dir);
+}
+
+// Multiply and xor-shift over 8 byte words
+uint64_t ElfCache::content_hash(std::span<const std::byte> data) {
+	uint64_t h = 0x9E3779B97F4A7C15ull ^ data.size();
+	size_t idx = 0;
+
+	for (; idx + 8 <= data.size(); idx += 8) {
+		uint64_t word;
+		std::memcpy(&word, data.data() + idx, sizeof(word));
+		h = (h ^ word) * 0xFF51AFD7ED558CCDull;
+		h ^= h >> 32;
+	}
+
+	uint64_t tail = 0;
+	std::memcpy(&tail, data.data() + idx, data.size() - idx);
+	h = (h ^ tail) * 0xC4CEB9FE1A85EC53ull;
+	return h ^ (h >> 29);
+}
+
+std::filesystem::path ElfCache::entry_path(const std::filesystem::path &path) const {
+	const std::string name = path.generic_string();
+	char file[32];
+
+	snprintf(file, sizeof(file), "%016" PRIx64 ".elfcache",
+		 content_hash({ reinterpret_cast<const std::byte*>(name.data()), name.size() }));
+	return dir / file;
+}
+
+ElfCache::Entry ElfCache::open(const std::filesystem::path &path, Elf::Access access) {
+	const std::filesystem::path file = std::filesystem::absolute(path).lexically_normal();
+	const uint64_t size = std::filesystem::file_size(file);
+	const int64_t mtime = static_cast<int64_t>(std::filesystem::last_write_time(file).time_since_epoch().count());
+	Entry entry;
+
+	try {
+		if (load(file, size, mtime, access, entry))
+			return entry;
+	} catch (...) {
+		// Damaged entry, parse the file again
+	}
+
+	entry = Entry();
+	entry.elf = std::make_unique<Elf>(file, access);
+
+	int index = entry.elf->find_section(".symtab");
+	if (index < 0)
+		index = entry.elf->find_section(".dynsym");
+
+	if (index >= 0) {
+		entry.elf->read_symbols(entry.symbols, index);
+		entry.addresses = std::make_unique<AddressIndex>(entry.symbols);
+	}
+
+	try {
+		const MappedFile content(file);
+		store(file, size, mtime, content_hash(content.data()), entry);
+	} catch (...) {
+		// Read-only or full cache directory, the result is still valid
+	}
+
+	return entry;
+}
+
+bool ElfCache::load(const std::filesystem::path &path, uint64_t size, int64_t mtime,
+		    Elf::Access access, Entry &entry) {
+	const std::filesystem::path name = entry_path(path);
+	if (!std::filesystem::exists(name))
+		return false;
+
+	const MappedFile cache(name);
+	if (cache.size() < sizeof(Header))
+		return false;
+
+	Header hdr;
+	std::memcpy(&hdr, cache.data().data(), sizeof(hdr));
+
+	if (std::memcmp(hdr.magic, magic, sizeof(magic)) || hdr.version != version || hdr.file_size != size)
+		return false;
+
+	// Different paths may share the entry name
+	const std::string full = path.generic_string();
+	const std::span<const char> stored = block<char>(cache, hdr.path);
+	if (full.size() != stored.size() || std::memcmp(full.data(), stored.data(), stored.size()))
+		return false;
+
+	uint64_t hash = hdr.hash;
+	if (hdr.mtime != mtime) {
+		const MappedFile content(path);
+		hash = content_hash(content.data());
+		if (hash != hdr.hash)
+			return false;
+	}
+
+	const Elf::Snapshot snapshot = {
+		hdr.header,
+		block<Elf64_Shdr>(cache, hdr.sections),
+		block<Elf64_Phdr>(cache, hdr.programs),
+		block<uint32_t>(cache, hdr.section_index),
+	};
+
+	entry.elf.reset(new Elf(path, access, snapshot));
+
+	if (hdr.symtab != UINT32_MAX) {
+		entry.elf->read_symbols(entry.symbols, hdr.symtab);
+		entry.symbols.load_index(block<uint32_t>(cache, hdr.symbol_index));
+		entry.addresses = std::make_unique<AddressIndex>(entry.symbols, block<uint32_t>(cache, hdr.address_index));
+	}
+
+	entry.hit = true;
+
+	// Record the new time, the next run does not need to hash the file
+	if (hdr.mtime != mtime) {
+		try {
+			store(path, size, mtime, hash, entry);
+		} catch (...) {
+		}
+	}
+
+	return true;
+}
+
+void ElfCache::store(const std::filesystem::path &path, uint64_t size, int64_t mtime, uint64_t hash,
+		     const Entry &entry) {
+	const Elf &elf = *entry.elf;
+	Writer writer;
+	Header hdr = {};
+
+	std::memcpy(hdr.magic, magic, sizeof(magic));
+	hdr.version = version;
+	hdr.file_size = size;
+	hdr.mtime = mtime;
+	hdr.hash = hash;
+	hdr.header = elf.get_file_header();
+
+	const std::string full = path.generic_string();
+	hdr.path = writer.append(std::span<const char>(full));
+
+	std::vector<Elf64_Shdr> sections(elf.get_sections().begin(), elf.get_sections().end());
+	hdr.sections = writer.append(std::span<const Elf64_Shdr>(sections));
+	hdr.programs = writer.append(std::span<const Elf64_Phdr>(elf.get_programs()));
+
+	std::vector<uint32_t> data;
+	elf.section_index.save(data);
+	hdr.section_index = writer.append(std::span<const uint32_t>(data));
+
+	hdr.symtab = UINT32_MAX;
+	if (entry.addresses) {
+		hdr.symtab = static_cast<uint32_t>(elf.find_section(entry.symbols.get_header().name_str));
+
+		data.clear();
+		entry.symbols.save_index(data);
+		hdr.symbol_index = writer.append(std::span<const uint32_t>(data));
+
+		data.clear();
+		entry.addresses->save(data);
+		hdr.address_index = writer.append(std::span<const uint32_t>(data));
+	}
+
+	std::memcpy(writer.data.data(), &hdr, sizeof(hdr));
+
+	// Readers never see a partial entry, concurrent writers replace each other
+	const std::filesystem::path name = entry_path(path);
+	std::filesystem::path temp = name;
+	temp += "." + std::to_string(std::random_device()()) + ".tmp";
+
+	{
+		std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(writer.data.data()), writer.data.size());
+		out.close();
+
+		if (!out) {
+			std::error_code ec;
+			std::filesystem::remove(temp, ec);
+			throw Exception("Cache write error.");
+		}
+	}
+
+	std::filesystem::rename(temp, name);
+}
@@ -0,0 +1,60 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright(c) 2023 Koko Software. All rights reserved.
+ *
+ * Author: Adrian Warecki <embedded@kokosoftware.pl>
+ */
+
+#ifndef __ELF_CACHE_HPP__
+#define __ELF_CACHE_HPP__
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+
+#include "Elf.hpp"
+#include "AddressIndex.hpp"
+
+namespace elf {
+	// Directory of parse results kept between runs. An entry holds the validated headers,
+	// the section name index, and the name and address indexes of the symbol table in a
+	// flat file that is mapped when loaded. Entries are found by the file path and used
+	// when the size and modification time match. A changed time alone is checked with a
+	// content hash, so fresh checkouts of unchanged files still hit.
+	class ElfCache {
+		public:
+			struct Entry {
+				std::unique_ptr<Elf> elf;
+				// .symtab or .dynsym, empty when the file has no symbol table
+				SymbolTable symbols;
+				std::unique_ptr<AddressIndex> addresses;
+				bool hit = false;
+			};
+
+			static constexpr uint32_t version = 1;
+
+			// The directory is created if it does not exist
+			ElfCache(std::filesystem::path dir);
+
+			// Restore the file from its entry or parse it and store a new entry. Damaged
+			// entries are parsed again, an entry that cannot be written is skipped.
+			Entry open(const std::filesystem::path &path, Elf::Access access = Elf::Access::Mapped);
+
+			// Entry file of the given file path
+			std::filesystem::path entry_path(const std::filesystem::path &path) const;
+
+			// Not cryptographic, only detects modified content
+			static uint64_t content_hash(std::span<const std::byte> data);
+
+		private:
+			std::filesystem::path dir;
+
+			bool load(const std::filesystem::path &path, uint64_t size, int64_t mtime,
+				  Elf::Access access, Entry &entry);
+			void store(const std::filesystem::path &path, uint64_t size, int64_t mtime, uint64_t hash,
+				   const Entry &entry);
+	};
+};
+
+#endif /* __ELF_CACHE_HPP__ */
@@ -0,0 +1,163 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Copyright(c) 2023 Koko Software. All rights reserved.
+//
+// Author: Adrian Warecki <embedded@kokosoftware.pl>
+
+#include "types.hpp"
+#include "ElfGenerator.hpp"
+#include "ElfTraits.hpp"
+
+#include <fstream>
+
+using namespace elf;
+
+static size_t align4(size_t value) {
+	return (value + 3) & ~size_t(3);
+}
+
+static void append(std::vector<std::byte> &out, const void *data, size_t size) {
+	const std::byte *bytes = static_cast<const std::byte*>(data);
+	out.insert(out.end(), bytes, bytes + size);
+}
+
+ElfGenerator::ElfGenerator(unsigned int sections, unsigned int symbols, size_t strtab_size,
+			   size_t section_size)
+	: sections(sections), symbols(symbols), section_size(section_size), padding(0)
+{
+	if (!sections)
+		throw Exception("At least one section is required.");
+
+	size_t size = 1;
+	for (unsigned int idx = 0; idx < symbols; idx++)
+		size += symbol_name(idx).size() + 1;
+
+	if (symbols && strtab_size > size)
+		padding = (strtab_size - size) / symbols;
+}
+
+std::string ElfGenerator::section_name(unsigned int index) const {
+	return ".text.s" + std::to_string(index);
+}
+
+std::string ElfGenerator::symbol_name(unsigned int index) const {
+	return "sym" + std::string(padding, '_') + std::to_string(index);
+}
+
+std::vector<std::byte> ElfGenerator::generate() const {
+	std::string strtab(1, '\0');
+	std::vector<Elf32_Sym> symtab(symbols + 1);
+
+	for (unsigned int idx = 0; idx < symbols; idx++) {
+		Elf32_Sym &sym = symtab[idx + 1];
+		sym.name = static_cast<Elf32_Word>(strtab.size());
+		sym.value = static_cast<Elf32_Addr>(section_size ? idx * 16 % section_size : 0);
+		sym.size = 16;
+		sym.info = ELF32_ST_INFO(STB_GLOBAL, STT_FUNC);
+		sym.other = 0;
+		sym.shndx = static_cast<Elf32_Half>(1 + idx % sections);
+
+		strtab += symbol_name(idx);
+		strtab += '\0';
+	}
+	std::memset(&symtab[0], 0, sizeof(Elf32_Sym));
+
+	std::string shstrtab(1, '\0');
+	std::vector<Elf32_Shdr> headers(sections + 4);
+	if (headers.size() >= SHN_LORESERVE)
+		throw Exception("Too many sections.");
+
+	std::memset(headers.data(), 0, headers.size() * sizeof(Elf32_Shdr));
+
+	auto add_name = [&](Elf32_Shdr &hdr, const std::string &name) {
+		hdr.name = static_cast<Elf32_Word>(shstrtab.size());
+		shstrtab += name;
+		shstrtab += '\0';
+	};
+
+	size_t offset = sizeof(Elf32_Ehdr);
+	for (unsigned int idx = 0; idx < sections; idx++) {
+		Elf32_Shdr &hdr = headers[idx + 1];
+		add_name(hdr, section_name(idx));
+		hdr.type = SHT_PROGBITS;
+		hdr.flags = SHF_ALLOC | SHF_EXECINSTR;
+		hdr.off = static_cast<Elf32_Off>(offset = align4(offset));
+		hdr.size = static_cast<Elf32_Word>(section_size);
+		hdr.addralign = 4;
+		offset += section_size;
+	}
+
+	const unsigned int symtab_index = sections + 1;
+	const unsigned int strtab_index = sections + 2;
+	const unsigned int shstrtab_index = sections + 3;
+
+	Elf32_Shdr &sym_hdr = headers[symtab_index];
+	add_name(sym_hdr, ".symtab");
+	sym_hdr.type = SHT_SYMTAB;
+	sym_hdr.off = static_cast<Elf32_Off>(offset = align4(offset));
+	sym_hdr.size = static_cast<Elf32_Word>(symtab.size() * sizeof(Elf32_Sym));
+	sym_hdr.link = strtab_index;
+	sym_hdr.info = 1;
+	sym_hdr.addralign = 4;
+	sym_hdr.entsize = sizeof(Elf32_Sym);
+	offset += sym_hdr.size;
+
+	Elf32_Shdr &str_hdr = headers[strtab_index];
+	add_name(str_hdr, ".strtab");
+	str_hdr.type = SHT_STRTAB;
+	str_hdr.off = static_cast<Elf32_Off>(offset);
+	str_hdr.size = static_cast<Elf32_Word>(strtab.size());
+	str_hdr.addralign = 1;
+	offset += strtab.size();
+
+	Elf32_Shdr &names_hdr = headers[shstrtab_index];
+	add_name(names_hdr, ".shstrtab");
+	names_hdr.type = SHT_STRTAB;
+	names_hdr.off = static_cast<Elf32_Off>(offset);
+	names_hdr.size = static_cast<Elf32_Word>(shstrtab.size());
+	names_hdr.addralign = 1;
+	offset += shstrtab.size();
+
+	Elf32_Ehdr ehdr;
+	std::memset(&ehdr, 0, sizeof(ehdr));
+	std::memcpy(ehdr.ident, ELFMAG, SELFMAG);
+	ehdr.ident[EI_CLASS] = ELFCLASS32;
+	ehdr.ident[EI_DATA] = ByteOrder<std::endian::native>::data;
+	ehdr.ident[EI_VERSION] = EV_CURRENT;
+	ehdr.type = ET_REL;
+	ehdr.machine = EM_386;
+	ehdr.version = EV_CURRENT;
+	ehdr.shoff = static_cast<Elf32_Off>(align4(offset));
+	ehdr.ehsize = sizeof(Elf32_Ehdr);
+	ehdr.shentsize = sizeof(Elf32_Shdr);
+	ehdr.shnum = static_cast<Elf32_Half>(headers.size());
+	ehdr.shstrndx = static_cast<Elf32_Half>(shstrtab_index);
+
+	std::vector<std::byte> out;
+	out.reserve(ehdr.shoff + headers.size() * sizeof(Elf32_Shdr));
+	append(out, &ehdr, sizeof(ehdr));
+
+	for (unsigned int idx = 0; idx < sections; idx++) {
+		out.resize(headers[idx + 1].off);
+		for (size_t pos = 0; pos < section_size; pos++)
+			out.push_back(std::byte((idx + pos) & 0xFF));
+	}
+
+	out.resize(sym_hdr.off);
+	append(out, symtab.data(), sym_hdr.size);
+	append(out, strtab.data(), strtab.size());
+	append(out, shstrtab.data(), shstrtab.size());
+	out.resize(ehdr.shoff);
+	append(out, headers.data(), headers.size() * sizeof(Elf32_Shdr));
+
+	return out;
+}
+
+void ElfGenerator::write(const std::filesystem::path &path) const {
+	const std::vector<std::byte> data = generate();
+
+	std::ofstream file(path, std::ios::binary);
+	file.write(reinterpret_cast<const char*>(data.data()), data.size());
+	if (!file)
+		throw String(_T("File write error."));
+}
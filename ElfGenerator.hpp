@@ -0,0 +1,44 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright(c) 2023 Koko Software. All rights reserved.
+ *
+ * Author: Adrian Warecki <embedded@kokosoftware.pl>
+ */
+
+#ifndef __ELF_GENERATOR_HPP__
+#define __ELF_GENERATOR_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace elf {
+	// Synthetic ELF32 relocatable file in host byte order with a controlled number
+	// of sections and symbols. Symbol names are padded to reach the requested
+	// string table size.
+	class ElfGenerator {
+		public:
+			ElfGenerator(unsigned int sections, unsigned int symbols, size_t strtab_size = 0,
+				     size_t section_size = 256);
+
+			std::vector<std::byte> generate() const;
+			void write(const std::filesystem::path &path) const;
+
+			// Names used in the generated file
+			std::string section_name(unsigned int index) const;
+			std::string symbol_name(unsigned int index) const;
+
+			unsigned int get_sections() const { return sections; }
+			unsigned int get_symbols() const { return symbols; }
+
+		private:
+			unsigned int sections;
+			unsigned int symbols;
+			size_t section_size;
+			size_t padding;
+	};
+};
+
+#endif /* __ELF_GENERATOR_HPP__ */
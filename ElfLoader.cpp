@@ -0,0 +1,185 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Copyright(c) 2023 Koko Software. All rights reserved.
+//
+// Author: Adrian Warecki <embedded@kokosoftware.pl>
+
+#include "types.hpp"
+#include "ElfLoader.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+using namespace elf;
+
+// Suspends the coroutine until the started request completes, the coroutine is resumed
+// by run(). Requests completing before the start returns are resumed by run() too.
+class ElfLoader::Io {
+	public:
+		using Start = std::function<void(AsyncReader::Handler handler)>;
+
+		Io(ElfLoader &loader, Start start) : loader(loader), start(std::move(start)) {}
+
+		bool await_ready() const noexcept { return false; }
+
+		void await_suspend(std::coroutine_handle<> handle) {
+			start([this, handle](std::exception_ptr result) {
+				error = result;
+				loader.post(handle);
+			});
+		}
+
+		void await_resume() {
+			if (error)
+				std::rethrow_exception(error);
+		}
+
+	private:
+		ElfLoader &loader;
+		Start start;
+		std::exception_ptr error;
+};
+
+// Coroutine of a spawned task, destroyed when it finishes
+struct ElfLoader::Detached {
+	struct promise_type {
+		Detached get_return_object() { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+
+ElfLoader::ElfLoader(unsigned int depth, AsyncReader::Backend backend)
+	: reader(depth, backend)
+{
+}
+
+void ElfLoader::post(std::coroutine_handle<> handle) {
+	std::lock_guard<std::mutex> guard(lock);
+	ready.push_back(handle);
+	wake.notify_one();
+}
+
+ElfLoader::Io ElfLoader::read(Elf &elf, uint64_t offset, std::span<std::byte> buffer) {
+	return Io(*this, [this, &elf, offset, buffer](AsyncReader::Handler handler) {
+		if (offset > uint64_t(elf.file_size) || buffer.size() > elf.file_size - offset)
+			throw String(_T("File read error."));
+
+		if (elf.mapping) {
+			std::memcpy(buffer.data(), elf.mapping->data().data() + offset, buffer.size());
+			handler(nullptr);
+			return;
+		}
+
+		reader.read(*elf.file, offset, buffer, std::move(handler));
+	});
+}
+
+Task<std::unique_ptr<Elf>> ElfLoader::open(std::filesystem::path path, Elf::Access access) {
+	std::unique_ptr<Elf> elf(new Elf(path, access, Elf::Deferred{}));
+
+	std::vector<std::byte> header(static_cast<size_t>(std::min<uint64_t>(sizeof(Elf64_Ehdr), elf->file_size)));
+	co_await read(*elf, 0, header);
+	elf->parse_header(header);
+
+	co_return std::move(elf);
+}
+
+Task<void> ElfLoader::load_sections(Elf &elf) {
+	if (!elf.sections.empty())
+		co_return;
+
+	const auto [offset, length] = elf.section_table();
+	std::vector<unsigned char> table(length);
+
+	co_await read(elf, offset, std::as_writable_bytes(std::span(table)));
+	elf.parse_sections(table.data());
+
+	co_await section(elf, elf.file_header.shstrndx, elf.section_names);
+	elf.index_section_names();
+}
+
+Task<void> ElfLoader::load_programs(Elf &elf) {
+	if (!elf.programs.empty() || !elf.file_header.phnum)
+		co_return;
+
+	const auto [offset, length] = elf.program_table();
+	std::vector<unsigned char> table(length);
+
+	co_await read(elf, offset, std::as_writable_bytes(std::span(table)));
+	elf.parse_programs(table.data());
+}
+
+Task<std::unique_ptr<Elf>> ElfLoader::load(std::filesystem::path path, Elf::Access access) {
+	std::unique_ptr<Elf> elf = co_await open(std::move(path), access);
+
+	co_await load_sections(*elf);
+	co_await load_programs(*elf);
+
+	co_return std::move(elf);
+}
+
+Task<void> ElfLoader::section(Elf &elf, unsigned int index, Section &section) {
+	co_await Io(*this, [this, &elf, index, &section](AsyncReader::Handler handler) {
+		reader.read_section(elf, index, section, std::move(handler));
+	});
+}
+
+Task<void> ElfLoader::section(Elf &elf, std::string name, Section &section) {
+	const int index = elf.find_section(name);
+	if (index < 0)
+		throw Exception("Section not found");
+
+	co_await this->section(elf, index, section);
+}
+
+Task<void> ElfLoader::symbols(Elf &elf, SymbolTable &symbols, std::string name) {
+	const int index = elf.find_section(name);
+	if (index < 0)
+		throw Exception("Section not found");
+
+	StringsTable strings;
+	co_await section(elf, elf.symbol_strings(index), strings);
+	co_await section(elf, index, symbols);
+
+	elf.link_symbols(symbols, index, strings);
+}
+
+ElfLoader::Detached ElfLoader::detach(ElfLoader &loader, Task<void> task) {
+	try {
+		co_await task;
+	}
+	catch (...) {
+		if (!loader.error)
+			loader.error = std::current_exception();
+	}
+
+	loader.running--;
+}
+
+void ElfLoader::spawn(Task<void> task) {
+	running++;
+	detach(*this, std::move(task));
+}
+
+void ElfLoader::run() {
+	while (running) {
+		std::coroutine_handle<> handle;
+
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			wake.wait(guard, [this] { return !ready.empty(); });
+			handle = ready.front();
+			ready.pop_front();
+		}
+
+		handle.resume();
+	}
+
+	if (error)
+		std::rethrow_exception(std::exchange(error, nullptr));
+}
@@ -0,0 +1,85 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright(c) 2023 Koko Software. All rights reserved.
+ *
+ * Author: Adrian Warecki <embedded@kokosoftware.pl>
+ */
+
+#ifndef __ELF_LOADER_HPP__
+#define __ELF_LOADER_HPP__
+
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "AsyncReader.hpp"
+#include "Elf.hpp"
+#include "Task.hpp"
+
+namespace elf {
+	// Incremental loading of many elf files on a single thread. Every phase of the Elf
+	// constructor is a coroutine suspended while its data is read by the AsyncReader,
+	// run() resumes the coroutines on the calling thread as their reads complete.
+	//
+	//	Task<> dump(ElfLoader &loader, std::filesystem::path path) {
+	//		std::unique_ptr<Elf> elf = co_await loader.open(path);
+	//		elf->get_file_header();
+	//		co_await loader.load_sections(*elf);
+	//		Section text;
+	//		co_await loader.section(*elf, ".text", text);
+	//	}
+	//
+	//	for (const auto &path : paths)
+	//		loader.spawn(dump(loader, path));
+	//	loader.run();
+	//
+	// Captures of a coroutine lambda do not live in its frame, pass state as parameters.
+	class ElfLoader {
+		public:
+			ElfLoader(unsigned int depth = AsyncReader::default_depth,
+				  AsyncReader::Backend backend = AsyncReader::Backend::Auto);
+
+			// Opens the file and reads the file header only
+			Task<std::unique_ptr<Elf>> open(std::filesystem::path path, Elf::Access access = Elf::Access::Stream);
+			// Section headers and their names, then the program headers. Each is loaded once.
+			Task<void> load_sections(Elf &elf);
+			Task<void> load_programs(Elf &elf);
+			// All headers, as read by the Elf constructor
+			Task<std::unique_ptr<Elf>> load(std::filesystem::path path, Elf::Access access = Elf::Access::Stream);
+
+			// Require the section headers
+			Task<void> section(Elf &elf, unsigned int index, Section &section);
+			Task<void> section(Elf &elf, std::string name, Section &section);
+			Task<void> symbols(Elf &elf, SymbolTable &symbols, std::string name = ".symtab");
+
+			// The task runs until its first read, then it continues in run()
+			void spawn(Task<void> task);
+			// Resume coroutines until all spawned tasks finish, then rethrow the first
+			// exception of a spawned task
+			void run();
+
+		private:
+			class Io;
+			struct Detached;
+
+			std::mutex lock;
+			std::condition_variable wake;
+			std::deque<std::coroutine_handle<>> ready;
+			size_t running = 0;
+			std::exception_ptr error;
+			// Destroyed first, its pending handlers still post to the queue
+			AsyncReader reader;
+
+			void post(std::coroutine_handle<> handle);
+			Io read(Elf &elf, uint64_t offset, std::span<std::byte> buffer);
+
+			static Detached detach(ElfLoader &loader, Task<void> task);
+	};
+};
+
+#endif /* __ELF_LOADER_HPP__ */
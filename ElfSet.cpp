@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Copyright(c) 2023 Koko Software. All rights reserved.
+//
+// Author: Adrian Warecki <embedded@kokosoftware.pl>
+
+#include "types.hpp"
+#include "ElfSet.hpp"
+
+#include <algorithm>
+
+using namespace elf;
+
+ElfSet::ElfSet(std::span<const std::filesystem::path> paths, Elf::Access access) {
+	ThreadPool pool;
+	open(paths, pool, access);
+}
+
+ElfSet::ElfSet(std::span<const std::filesystem::path> paths, ThreadPool &pool, Elf::Access access) {
+	open(paths, pool, access);
+}
+
+void ElfSet::open(std::span<const std::filesystem::path> paths, ThreadPool &pool, Elf::Access access) {
+	entries.resize(paths.size());
+	for (size_t idx = 0; idx < paths.size(); idx++)
+		entries[idx].path = paths[idx];
+
+	// Each task writes only its own entry
+	for (Entry &entry : entries) {
+		pool.submit([&entry, access] {
+			try {
+				entry.elf = std::make_unique<Elf>(entry.path, access);
+			} catch (const std::exception &err) {
+				entry.error = err.what();
+			} catch (const String &err) {
+				// Messages are plain ASCII
+				entry.error.assign(err.begin(), err.end());
+			} catch (...) {
+				entry.error = "Unknown error.";
+			}
+		});
+	}
+
+	pool.wait();
+}
+
+std::vector<std::filesystem::path> ElfSet::list(const std::filesystem::path &dir) {
+	std::vector<std::filesystem::path> paths;
+
+	for (const auto &item : std::filesystem::directory_iterator(dir))
+		if (item.is_regular_file())
+			paths.push_back(item.path());
+
+	std::sort(paths.begin(), paths.end());
+	return paths;
+}
+
+size_t ElfSet::failed() const {
+	return std::count_if(entries.begin(), entries.end(), [](const Entry &entry) {
+		return !entry.elf;
+	});
+}
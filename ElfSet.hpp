@@ -0,0 +1,57 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright(c) 2023 Koko Software. All rights reserved.
+ *
+ * Author: Adrian Warecki <embedded@kokosoftware.pl>
+ */
+
+#ifndef __ELF_SET_HPP__
+#define __ELF_SET_HPP__
+
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "Elf.hpp"
+#include "ThreadPool.hpp"
+
+namespace elf {
+	// Set of elf files opened and validated concurrently. Entries keep the order
+	// of the given paths, a file that fails to open does not affect the others.
+	class ElfSet {
+		public:
+			struct Entry {
+				std::filesystem::path path;
+				std::unique_ptr<Elf> elf;	// nullptr if the file failed to open
+				std::string error;
+			};
+
+			ElfSet(std::span<const std::filesystem::path> paths,
+			       Elf::Access access = Elf::Access::Mapped);
+			ElfSet(std::span<const std::filesystem::path> paths, ThreadPool &pool,
+			       Elf::Access access = Elf::Access::Mapped);
+
+			// Regular files of the directory sorted by name
+			static std::vector<std::filesystem::path> list(const std::filesystem::path &dir);
+
+			size_t size() const { return entries.size(); }
+			size_t failed() const;
+
+			Entry &operator[](size_t index) { return entries[index]; }
+			const Entry &operator[](size_t index) const { return entries[index]; }
+
+			std::vector<Entry>::iterator begin() { return entries.begin(); }
+			std::vector<Entry>::iterator end() { return entries.end(); }
+			std::vector<Entry>::const_iterator begin() const { return entries.begin(); }
+			std::vector<Entry>::const_iterator end() const { return entries.end(); }
+
+		private:
+			std::vector<Entry> entries;
+
+			void open(std::span<const std::filesystem::path> paths, ThreadPool &pool, Elf::Access access);
+	};
+};
+
+#endif /* __ELF_SET_HPP__ */
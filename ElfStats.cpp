@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Copyright(c) 2023 Koko Software. All rights reserved.
+//
+// Author: Adrian Warecki <embedded@kokosoftware.pl>
+
+#include "types.hpp"
+#include "ElfStats.hpp"
+
+#include <cinttypes>
+#include <cstdarg>
+#include <iterator>
+
+using namespace elf;
+
+namespace {
+	struct Counter {
+		const char *name;
+		uint64_t ElfStats::*value;
+		const char *help;
+	};
+
+	struct Phase {
+		const char *name;
+		ElfStats::Timer ElfStats::*timer;
+	};
+
+	const Counter counters[] = {
+		{ "bytes_read", &ElfStats::bytes_read, "Bytes read from the file." },
+		{ "read_calls", &ElfStats::read_calls, "Read operations." },
+		{ "allocations", &ElfStats::allocations, "Buffers allocated." },
+		{ "bytes_allocated", &ElfStats::bytes_allocated, "Bytes allocated for buffers." },
+	};
+
+	const Phase phases[] = {
+		{ "read_header", &ElfStats::read_header },
+		{ "read_sections", &ElfStats::read_sections },
+		{ "update_section_names", &ElfStats::update_section_names },
+		{ "read_programs", &ElfStats::read_programs },
+		{ "read_section", &ElfStats::read_section },
+	};
+}
+
+static void append(std::string &out, const char *format, ...) {
+	char line[512];
+	va_list args;
+
+	va_start(args, format);
+	vsnprintf(line, sizeof(line), format, args);
+	va_end(args);
+
+	out += line;
+}
+
+ElfStats &ElfStats::operator+=(const ElfStats &other) {
+	for (const Counter &counter : counters)
+		this->*counter.value += other.*counter.value;
+
+	for (const Phase &phase : phases) {
+		(this->*phase.timer).calls += (other.*phase.timer).calls;
+		(this->*phase.timer).nanoseconds += (other.*phase.timer).nanoseconds;
+	}
+
+	return *this;
+}
+
+std::string ElfStats::to_json() const {
+	std::string out = "{";
+
+	for (const Counter &counter : counters)
+		append(out, "\"%s\": %" PRIu64 ", ", counter.name, this->*counter.value);
+
+	out += "\"phases\": {";
+	for (size_t idx = 0; idx < std::size(phases); idx++) {
+		const Timer &timer = this->*phases[idx].timer;
+		append(out, "%s\"%s\": {\"calls\": %" PRIu64 ", \"seconds\": %.9f}", idx ? ", " : "",
+		       phases[idx].name, timer.calls, timer.nanoseconds / 1e9);
+	}
+	out += "}}";
+
+	return out;
+}
+
+std::string ElfStats::to_prometheus(std::string_view prefix) const {
+	const std::string name(prefix);
+	std::string out;
+
+	for (const Counter &counter : counters) {
+		append(out, "# HELP %s_%s_total %s\n", name.c_str(), counter.name, counter.help);
+		append(out, "# TYPE %s_%s_total counter\n", name.c_str(), counter.name);
+		append(out, "%s_%s_total %" PRIu64 "\n", name.c_str(), counter.name, this->*counter.value);
+	}
+
+	append(out, "# HELP %s_phase_calls_total Calls of a parse phase.\n", name.c_str());
+	append(out, "# TYPE %s_phase_calls_total counter\n", name.c_str());
+	for (const Phase &phase : phases)
+		append(out, "%s_phase_calls_total{phase=\"%s\"} %" PRIu64 "\n", name.c_str(), phase.name,
+		       (this->*phase.timer).calls);
+
+	append(out, "# HELP %s_phase_seconds_total Time spent in a parse phase.\n", name.c_str());
+	append(out, "# TYPE %s_phase_seconds_total counter\n", name.c_str());
+	for (const Phase &phase : phases)
+		append(out, "%s_phase_seconds_total{phase=\"%s\"} %.9f\n", name.c_str(), phase.name,
+		       (this->*phase.timer).nanoseconds / 1e9);
+
+	return out;
+}
@@ -0,0 +1,73 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright(c) 2023 Koko Software. All rights reserved.
+ *
+ * Author: Adrian Warecki <embedded@kokosoftware.pl>
+ */
+
+#ifndef __ELF_STATS_HPP__
+#define __ELF_STATS_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace elf {
+	// I/O and parse counters of a single Elf. Collected only when the whole build
+	// defines ELF_STATS, otherwise the instrumentation compiles to nothing. Counters are
+	// updated atomically, sections may be read by several threads at once.
+	struct ElfStats {
+		struct Timer {
+			alignas(8) uint64_t calls = 0;
+			alignas(8) uint64_t nanoseconds = 0;
+		};
+
+		// Adds the lifetime of the scope to the timer
+		class Scope {
+			public:
+				Scope(Timer &timer) : timer(timer), start(std::chrono::steady_clock::now()) {}
+				~Scope() {
+					const auto elapsed = std::chrono::steady_clock::now() - start;
+					add(timer.calls, 1);
+					add(timer.nanoseconds, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+				}
+
+			private:
+				Timer &timer;
+				std::chrono::steady_clock::time_point start;
+		};
+
+		alignas(8) uint64_t bytes_read = 0;
+		alignas(8) uint64_t read_calls = 0;
+		alignas(8) uint64_t allocations = 0;
+		alignas(8) uint64_t bytes_allocated = 0;
+
+		Timer read_header;
+		Timer read_sections;
+		Timer update_section_names;
+		Timer read_programs;
+		Timer read_section;
+
+		ElfStats &operator+=(const ElfStats &other);
+
+		static void add(uint64_t &counter, uint64_t value) {
+			std::atomic_ref<uint64_t>(counter).fetch_add(value, std::memory_order_relaxed);
+		}
+
+		std::string to_json() const;
+		// Prometheus text exposition format, metric names start with prefix
+		std::string to_prometheus(std::string_view prefix = "elf") const;
+	};
+};
+
+#ifdef ELF_STATS
+#define ELF_STATS_ADD(counter, value) ElfStats::add(stats.counter, (value))
+#define ELF_STATS_TIME(timer) ElfStats::Scope stats_scope(stats.timer)
+#else
+#define ELF_STATS_ADD(counter, value) ((void)0)
+#define ELF_STATS_TIME(timer) ((void)0)
+#endif
+
+#endif /* __ELF_STATS_HPP__ */
@@ -0,0 +1,305 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Copyright(c) 2023 Koko Software. All rights reserved.
+//
+// Author: Adrian Warecki <embedded@kokosoftware.pl>
+
+#include "types.hpp"
+#include "ElfStream.hpp"
+#include "ElfTraits.hpp"
+#include "Image.hpp"
+
+#include <algorithm>
+
+using namespace elf;
+
+static constexpr size_t block_size = 64 * 1024;
+
+// Size of a table with count entries spaced by entsize bytes, the last entry may be shorter
+static uint64_t table_size(uint64_t count, uint64_t entsize, uint64_t size) {
+	return count ? (count - 1) * entsize + size : 0;
+}
+
+ElfStream::ElfStream(std::istream &stream)
+	: stream(stream)
+{
+	std::memset(&file_header, 0, sizeof(file_header));
+}
+
+void ElfStream::on_section(std::string_view name, SectionHandler handler) {
+	requests.push_back({ std::string(name), std::move(handler) });
+}
+
+void ElfStream::on_segment(SegmentHandler handler) {
+	segment_handler = std::move(handler);
+}
+
+void ElfStream::read_image(ImageInterface &image) {
+	this->image = &image;
+}
+
+// Data is held back while some headers which may refer to it are missing
+bool ElfStream::retaining() const {
+	if (!header_known)
+		return true;
+
+	if ((segment_handler || image) && !programs_known)
+		return true;
+
+	return !requests.empty() && !names_known;
+}
+
+void ElfStream::run() {
+	std::vector<std::byte> block(block_size);
+
+	add(Kind::Ident, 0, EI_NIDENT);
+
+	while (stream) {
+		stream.read(reinterpret_cast<char*>(block.data()), block.size());
+		const std::span<const std::byte> data(block.data(), static_cast<size_t>(stream.gcount()));
+		if (data.empty())
+			break;
+
+		// Headers completed by this block may refer to any part of it
+		if (retaining())
+			retain(data);
+
+		for (Target &target : targets)
+			feed(target, position, data);
+
+		position += data.size();
+		complete();
+
+		if (!retaining()) {
+			retained.clear();
+			retained.shrink_to_fit();
+		}
+	}
+
+	if (stream.bad())
+		throw String(_T("File read error."));
+
+	if (!header_known || !targets.empty())
+		throw Exception("Unexpected end of stream.");
+}
+
+// The retained data always starts at the beginning of the file
+void ElfStream::retain(std::span<const std::byte> data) {
+	retained.insert(retained.end(), data.begin(), data.end());
+	peak_buffered = std::max(peak_buffered, retained.size());
+}
+
+void ElfStream::add(Kind kind, uint64_t start, uint64_t size, unsigned int index, const Request *request) {
+	Target target{ kind, start, size, index, 0, request, {}, {} };
+
+	if (kind == Kind::Segment) {
+		if (image)
+			target.destination = image->process(programs[index].paddr, programs[index].memsz);
+	} else {
+		target.buffer.reset(new unsigned char[size]);
+	}
+
+	// Part of the range which already passed has to be retained
+	if (start < position) {
+		feed(target, 0, retained);
+		if (target.received < std::min(size, position - start))
+			throw Exception("Stream data preceding its headers was not retained.");
+	}
+
+	targets.push_back(std::move(target));
+}
+
+void ElfStream::feed(Target &target, uint64_t start, std::span<const std::byte> data) {
+	const uint64_t from = std::max(start, target.start + target.received);
+	const uint64_t to = std::min(start + data.size(), target.start + target.size);
+
+	if (from >= to)
+		return;
+
+	const std::span<const std::byte> chunk = data.subspan(from - start, to - from);
+
+	if (target.kind == Kind::Segment) {
+		if (!target.destination.empty())
+			std::memcpy(target.destination.data() + target.received, chunk.data(), chunk.size());
+
+		if (segment_handler)
+			segment_handler(programs[target.index], target.received, chunk);
+	} else {
+		std::memcpy(target.buffer.get() + target.received, chunk.data(), chunk.size());
+	}
+
+	target.received += chunk.size();
+}
+
+// Finishing a target may schedule new ones which are already complete
+void ElfStream::complete() {
+	for (size_t idx = 0; idx < targets.size();) {
+		if (targets[idx].received < targets[idx].size) {
+			idx++;
+			continue;
+		}
+
+		Target target = std::move(targets[idx]);
+		targets.erase(targets.begin() + idx);
+		finish(target);
+		idx = 0;
+	}
+}
+
+void ElfStream::finish(Target &target) {
+	switch (target.kind) {
+		case Kind::Ident:
+			check_ident(target.buffer.get());
+			std::memcpy(file_header.ident, target.buffer.get(), EI_NIDENT);
+			add(Kind::Header, 0, file_header.ident[EI_CLASS] == ELFCLASS32 ? sizeof(Elf32_Ehdr) : sizeof(Elf64_Ehdr));
+			break;
+
+		case Kind::Header:
+			with_traits(file_header.ident, [&]<typename Traits>() {
+				parse_header<Traits>(target.buffer.get());
+			});
+			break;
+
+		case Kind::Programs:
+			with_traits(file_header.ident, [&]<typename Traits>() {
+				parse_programs<Traits>(target.buffer.get());
+			});
+			break;
+
+		case Kind::Sections:
+			with_traits(file_header.ident, [&]<typename Traits>() {
+				parse_sections<Traits>(target.buffer.get());
+			});
+			break;
+
+		case Kind::Names:
+			section_names.header = sections[target.index];
+			section_names.buffer = target.buffer;
+			parse_names();
+			break;
+
+		case Kind::Section: {
+			Section section;
+			section.header = sections[target.index];
+			section.buffer = target.buffer;
+			target.request->handler(section);
+			break;
+		}
+
+		case Kind::Segment: {
+			const Elf64_Phdr &hdr = programs[target.index];
+			if (!target.destination.empty()) {
+				std::memset(target.destination.data() + hdr.filesz, 0, hdr.memsz - hdr.filesz);
+				image->complete(hdr.paddr, target.destination);
+			}
+			break;
+		}
+	}
+}
+
+template <typename Traits>
+void ElfStream::parse_header(const unsigned char *data) {
+	typename Traits::Ehdr hdr;
+	std::memcpy(&hdr, data, sizeof(hdr));
+	file_header = to_host<Traits>(hdr);
+
+	if (file_header.version != EV_CURRENT)
+		throw Exception("Unsupported file version.");
+
+	if (file_header.ehsize < sizeof(typename Traits::Ehdr))
+		throw Exception("Invalid file header size.");
+
+	if (file_header.phnum && file_header.phentsize < sizeof(typename Traits::Phdr))
+		throw Exception("Invalid program header size.");
+
+	if (file_header.shnum && file_header.shentsize < sizeof(typename Traits::Shdr))
+		throw Exception("Invalid section header size.");
+
+	if (file_header.shnum && file_header.shstrndx >= file_header.shnum)
+		throw Exception("Invalid section name strings section index.");
+
+	header_known = true;
+
+	if (file_header.phnum)
+		add(Kind::Programs, file_header.phoff,
+		    table_size(file_header.phnum, file_header.phentsize, sizeof(typename Traits::Phdr)));
+	else
+		programs_known = true;
+
+	if (file_header.shnum)
+		add(Kind::Sections, file_header.shoff,
+		    table_size(file_header.shnum, file_header.shentsize, sizeof(typename Traits::Shdr)));
+	else
+		names_known = true;
+}
+
+template <typename Traits>
+void ElfStream::parse_programs(const unsigned char *table) {
+	programs.resize(file_header.phnum);
+
+	for (auto idx = 0; idx < file_header.phnum; idx++) {
+		typename Traits::Phdr hdr;
+		std::memcpy(&hdr, table, sizeof(hdr));
+		programs[idx] = to_host<Traits>(hdr);
+
+		if (programs[idx].filesz > programs[idx].memsz)
+			throw Exception("Invalid program header.");
+
+		table += file_header.phentsize;
+	}
+
+	programs_known = true;
+
+	if (!segment_handler && !image)
+		return;
+
+	// Use only load headers with content in file
+	for (auto idx = 0; idx < file_header.phnum; idx++) {
+		if (programs[idx].type == PT_LOAD && programs[idx].filesz)
+			add(Kind::Segment, programs[idx].off, programs[idx].filesz, idx);
+	}
+}
+
+template <typename Traits>
+void ElfStream::parse_sections(const unsigned char *table) {
+	sections.reserve(file_header.shnum);
+
+	for (auto idx = 0; idx < file_header.shnum; idx++) {
+		typename Traits::Shdr hdr;
+		std::memcpy(&hdr, table, sizeof(hdr));
+
+		sections.emplace_back(to_host<Traits>(hdr));
+
+		table += file_header.shentsize;
+	}
+
+	const SectionHeader &names = sections[file_header.shstrndx];
+	if (names.type == SHT_NOBITS)
+		throw Exception("Cannot read SHT_NOBITS section.");
+
+	// Names which passed without being retained are not needed by any request
+	if (std::max<uint64_t>(names.off, retained.size()) < std::min(names.off + names.size, position)) {
+		names_known = true;
+		return;
+	}
+
+	add(Kind::Names, names.off, names.size, file_header.shstrndx);
+}
+
+void ElfStream::parse_names() {
+	for (SectionHeader &header : sections)
+		header.update_name(section_names);
+
+	names_known = true;
+
+	for (const Request &request : requests) {
+		auto it = std::find_if(sections.begin(), sections.end(), [&](const SectionHeader &header) {
+			return header.name_str == request.name;
+		});
+
+		if (it == sections.end() || it->type == SHT_NOBITS)
+			continue;
+
+		add(Kind::Section, it->off, it->size, static_cast<unsigned int>(it - sections.begin()), &request);
+	}
+}
@@ -0,0 +1,109 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright(c) 2023 Koko Software. All rights reserved.
+ *
+ * Author: Adrian Warecki <embedded@kokosoftware.pl>
+ */
+
+#ifndef __ELF_STREAM_HPP__
+#define __ELF_STREAM_HPP__
+
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Elf.hpp"
+
+namespace elf {
+	class ImageInterface;
+
+	// Single pass parser for non-seekable inputs like pipes and stdin. Headers are
+	// parsed as soon as they arrive, requested sections and loadable segments are
+	// delivered in file offset order. Only the data which arrives before the
+	// headers describing it is buffered.
+	class ElfStream {
+		public:
+			using SectionHandler = std::function<void(const Section &section)>;
+			// Part of the file content of a PT_LOAD segment at offset from its start
+			using SegmentHandler = std::function<void(const Elf64_Phdr &segment, uint64_t offset,
+								  std::span<const std::byte> data)>;
+
+			ElfStream(std::istream &stream);
+
+			// Handler is called once the whole section is received
+			void on_section(std::string_view name, SectionHandler handler);
+			void on_segment(SegmentHandler handler);
+			// Copy PT_LOAD segments into the image while they arrive, zero filling up to memsz
+			void read_image(ImageInterface &image);
+
+			// Consume the stream up to its end
+			void run();
+
+			const Elf64_Ehdr &get_file_header() const { return file_header; }
+			const std::vector<SectionHeader> &get_sections() const { return sections; }
+			const StringsTable &get_section_names() const { return section_names; }
+			const std::vector<Elf64_Phdr> &get_programs() const { return programs; }
+			// Largest amount of data held back waiting for headers
+			size_t get_buffered() const { return peak_buffered; }
+
+		private:
+			std::istream &stream;
+
+			Elf64_Ehdr file_header;
+			std::vector<SectionHeader> sections;
+			std::vector<Elf64_Phdr> programs;
+			StringsTable section_names;
+
+			struct Request {
+				std::string name;
+				SectionHandler handler;
+			};
+			std::vector<Request> requests;
+			SegmentHandler segment_handler;
+			ImageInterface *image = nullptr;
+
+			enum class Kind { Ident, Header, Programs, Sections, Names, Section, Segment };
+
+			// Range of the file waiting for its data
+			struct Target {
+				Kind kind;
+				uint64_t start;
+				uint64_t size;
+				unsigned int index;	// Section or program header index
+				uint64_t received;
+				const Request *request;
+				std::shared_ptr<unsigned char[]> buffer;
+				std::span<std::byte> destination;
+			};
+			std::vector<Target> targets;
+
+			// Data from the beginning of the file received before the headers
+			std::vector<std::byte> retained;
+			size_t peak_buffered = 0;
+
+			uint64_t position = 0;
+			bool header_known = false;
+			bool programs_known = false;
+			bool names_known = false;
+
+			bool retaining() const;
+			void retain(std::span<const std::byte> data);
+			void add(Kind kind, uint64_t start, uint64_t size, unsigned int index = 0,
+				 const Request *request = nullptr);
+			void feed(Target &target, uint64_t start, std::span<const std::byte> data);
+			void complete();
+			void finish(Target &target);
+
+			template <typename Traits> void parse_header(const unsigned char *data);
+			template <typename Traits> void parse_programs(const unsigned char *table);
+			template <typename Traits> void parse_sections(const unsigned char *table);
+			void parse_names();
+	};
+};
+
+#endif /* __ELF_STREAM_HPP__ */
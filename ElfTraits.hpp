@@ -0,0 +1,196 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright(c) 2023 Koko Software. All rights reserved.
+ *
+ * Author: Adrian Warecki <embedded@kokosoftware.pl>
+ */
+
+#ifndef __ELF_TRAITS_HPP__
+#define __ELF_TRAITS_HPP__
+
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+#include "elf.h"
+
+namespace elf {
+	template <typename T>
+	constexpr T byteswap(T value) {
+		using U = std::make_unsigned_t<T>;
+		U in = static_cast<U>(value);
+		U out = 0;
+
+		for (size_t idx = 0; idx < sizeof(T); idx++) {
+			out = static_cast<U>((out << 8) | (in & 0xFF));
+			in = static_cast<U>(in >> 8);
+		}
+
+		return static_cast<T>(out);
+	}
+
+	// Conversion of file fields to the host byte order, a no-op for the native order
+	template <std::endian Order>
+	struct ByteOrder {
+		static constexpr bool native = Order == std::endian::native;
+		static constexpr unsigned char data = Order == std::endian::little ? ELFDATA2LSB : ELFDATA2MSB;
+
+		template <typename T>
+		static constexpr T get(T value) {
+			if constexpr (native || sizeof(T) == 1)
+				return value;
+			else
+				return byteswap(value);
+		}
+	};
+
+	using LittleEndian = ByteOrder<std::endian::little>;
+	using BigEndian = ByteOrder<std::endian::big>;
+
+	template <typename Order>
+	struct Elf32Traits : Order {
+		static constexpr unsigned char elf_class = ELFCLASS32;
+
+		using Ehdr = Elf32_Ehdr;
+		using Shdr = Elf32_Shdr;
+		using Phdr = Elf32_Phdr;
+		using Sym = Elf32_Sym;
+		using Chdr = Elf32_Chdr;
+
+		static Elf32_Addr addr(const Shdr &hdr) { return hdr.vaddr; }
+	};
+
+	template <typename Order>
+	struct Elf64Traits : Order {
+		static constexpr unsigned char elf_class = ELFCLASS64;
+
+		using Ehdr = Elf64_Ehdr;
+		using Shdr = Elf64_Shdr;
+		using Phdr = Elf64_Phdr;
+		using Sym = Elf64_Sym;
+		using Chdr = Elf64_Chdr;
+
+		static Elf64_Addr addr(const Shdr &hdr) { return hdr.addr; }
+	};
+
+	// Throws unless the identification describes a supported class and byte order
+	inline void check_ident(const unsigned char *ident) {
+		if (std::memcmp(ident, ELFMAG, SELFMAG))
+			throw Exception("Unsupported elf file.");
+
+		if ((ident[EI_CLASS] != ELFCLASS32 && ident[EI_CLASS] != ELFCLASS64) ||
+		    (ident[EI_DATA] != ELFDATA2LSB && ident[EI_DATA] != ELFDATA2MSB) ||
+		    ident[EI_VERSION] != EV_CURRENT)
+			throw Exception("Unsupported elf file.");
+	}
+
+	// Call func.template operator()<Traits>() for the class and byte order of the identification
+	template <typename F>
+	void with_traits(const unsigned char *ident, F &&func) {
+		if (ident[EI_CLASS] == ELFCLASS32) {
+			if (ident[EI_DATA] == ELFDATA2LSB)
+				func.template operator()<Elf32Traits<LittleEndian>>();
+			else
+				func.template operator()<Elf32Traits<BigEndian>>();
+		} else {
+			if (ident[EI_DATA] == ELFDATA2LSB)
+				func.template operator()<Elf64Traits<LittleEndian>>();
+			else
+				func.template operator()<Elf64Traits<BigEndian>>();
+		}
+	}
+
+	// Headers of any class and byte order are widened to Elf64 structures in host byte order
+	template <typename Order>
+	Elf64_Ehdr to_host(const Elf32_Ehdr &in) {
+		Elf64_Ehdr out;
+
+		std::memcpy(out.ident, in.ident, sizeof(out.ident));
+		out.type = Order::get(in.type);
+		out.machine = Order::get(in.machine);
+		out.version = Order::get(in.version);
+		out.entry = Order::get(in.entry);
+		out.phoff = Order::get(in.phoff);
+		out.shoff = Order::get(in.shoff);
+		out.flags = Order::get(in.flags);
+		out.ehsize = Order::get(in.ehsize);
+		out.phentsize = Order::get(in.phentsize);
+		out.phnum = Order::get(in.phnum);
+		out.shentsize = Order::get(in.shentsize);
+		out.shnum = Order::get(in.shnum);
+		out.shstrndx = Order::get(in.shstrndx);
+		return out;
+	}
+
+	template <typename Order>
+	Elf64_Ehdr to_host(const Elf64_Ehdr &in) {
+		if constexpr (Order::native)
+			return in;
+
+		Elf64_Ehdr out = in;
+		out.type = Order::get(in.type);
+		out.machine = Order::get(in.machine);
+		out.version = Order::get(in.version);
+		out.entry = Order::get(in.entry);
+		out.phoff = Order::get(in.phoff);
+		out.shoff = Order::get(in.shoff);
+		out.flags = Order::get(in.flags);
+		out.ehsize = Order::get(in.ehsize);
+		out.phentsize = Order::get(in.phentsize);
+		out.phnum = Order::get(in.phnum);
+		out.shentsize = Order::get(in.shentsize);
+		out.shnum = Order::get(in.shnum);
+		out.shstrndx = Order::get(in.shstrndx);
+		return out;
+	}
+
+	template <typename Traits>
+	Elf64_Shdr to_host(const typename Traits::Shdr &in) {
+		Elf64_Shdr out;
+
+		out.name = Traits::get(in.name);
+		out.type = Traits::get(in.type);
+		out.flags = Traits::get(in.flags);
+		out.addr = Traits::get(Traits::addr(in));
+		out.off = Traits::get(in.off);
+		out.size = Traits::get(in.size);
+		out.link = Traits::get(in.link);
+		out.info = Traits::get(in.info);
+		out.addralign = Traits::get(in.addralign);
+		out.entsize = Traits::get(in.entsize);
+		return out;
+	}
+
+	template <typename Traits>
+	Elf64_Phdr to_host(const typename Traits::Phdr &in) {
+		Elf64_Phdr out;
+
+		out.type = Traits::get(in.type);
+		out.flags = Traits::get(in.flags);
+		out.off = Traits::get(in.off);
+		out.vaddr = Traits::get(in.vaddr);
+		out.paddr = Traits::get(in.paddr);
+		out.filesz = Traits::get(in.filesz);
+		out.memsz = Traits::get(in.memsz);
+		out.align = Traits::get(in.align);
+		return out;
+	}
+
+	template <typename Traits>
+	Elf64_Chdr to_host(const typename Traits::Chdr &in) {
+		Elf64_Chdr out;
+
+		out.type = Traits::get(in.type);
+		out.reserved = 0;
+		out.size = Traits::get(in.size);
+		out.addralign = Traits::get(in.addralign);
+		return out;
+	}
+
+	// Symbols of the traits can be used in place as Elf32_Sym
+	template <typename Traits>
+	constexpr bool native_symbols = std::is_same_v<typename Traits::Sym, Elf32_Sym> && Traits::native;
+};
+
+#endif /* __ELF_TRAITS_HPP__ */
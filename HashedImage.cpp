@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Copyright(c) 2023 Koko Software. All rights reserved.
+//
+// Author: Adrian Warecki <embedded@kokosoftware.pl>
+
+#include "types.hpp"
+#include "HashedImage.hpp"
+
+#include <algorithm>
+
+using namespace elf;
+
+HashedImage::HashedImage(uint64_t base, size_t size, ThreadPool &pool, unsigned int algorithms)
+	: Image(base, size), pool(pool), algorithms(algorithms)
+{
+}
+
+HashedImage::~HashedImage() {
+	wait();
+}
+
+// Tasks of this image are counted on their own, the pool may be shared
+template <typename F>
+void HashedImage::run(F &&func) {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		running++;
+	}
+
+	pool.submit([this, func = std::forward<F>(func)] {
+		func();
+
+		std::lock_guard<std::mutex> guard(lock);
+		if (!--running)
+			idle.notify_all();
+	});
+}
+
+void HashedImage::wait() {
+	std::unique_lock<std::mutex> guard(lock);
+	idle.wait(guard, [this] { return !running; });
+}
+
+void HashedImage::complete(uint64_t address, std::span<const std::byte> data) {
+	Segment &segment = pending.emplace_back(Segment{ address, data.size(), {} });
+
+	// Both digests of a segment run in parallel too
+	if (algorithms & SHA256)
+		run([&segment, data] { segment.digests.sha256 = Sha256::digest(data); });
+
+	if (algorithms & SHA384)
+		run([&segment, data] { segment.digests.sha384 = Sha384::digest(data); });
+}
+
+void HashedImage::finish() {
+	const std::span<const std::byte> image = data();
+
+	// Image digests overlap with the segment ones still running
+	if (algorithms & SHA384)
+		run([this, image] { digests.sha384 = Sha384::digest(image); });
+
+	if (algorithms & SHA256)
+		digests.sha256 = Sha256::digest(image);
+
+	wait();
+
+	segments.assign(pending.begin(), pending.end());
+	std::sort(segments.begin(), segments.end(), [](const Segment &a, const Segment &b) {
+		return a.address < b.address;
+	});
+}
@@ -0,0 +1,76 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright(c) 2023 Koko Software. All rights reserved.
+ *
+ * Author: Adrian Warecki <embedded@kokosoftware.pl>
+ */
+
+#ifndef __HASHED_IMAGE_HPP__
+#define __HASHED_IMAGE_HPP__
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include "Image.hpp"
+#include "Sha.hpp"
+#include "ThreadPool.hpp"
+
+namespace elf {
+	// Image that hashes every segment as soon as it is written. Segment hashes run on
+	// the pool while the following segments are read, the whole image is hashed by
+	// finish() once the gaps are filled. Digests of algorithms not selected stay zero.
+	class HashedImage : public Image {
+		public:
+			enum Algorithm : unsigned int {
+				SHA256 = 1,
+				SHA384 = 2,
+			};
+
+			struct Digests {
+				Sha256::Digest sha256 = {};
+				Sha384::Digest sha384 = {};
+			};
+
+			struct Segment {
+				uint64_t address;
+				size_t size;
+				Digests digests;
+			};
+
+			HashedImage(uint64_t base, size_t size, ThreadPool &pool, unsigned int algorithms = SHA256 | SHA384);
+			// Waits for the hashes still running
+			~HashedImage();
+
+			void complete(uint64_t address, std::span<const std::byte> data) override;
+
+			// Wait for the segment digests and hash the whole image
+			void finish();
+
+			// Sorted by address, valid after finish()
+			const std::vector<Segment> &get_segments() const { return segments; }
+			const Digests &get_digests() const { return digests; }
+
+		private:
+			ThreadPool &pool;
+			unsigned int algorithms;
+
+			// Stable addresses for the running tasks
+			std::deque<Segment> pending;
+			std::vector<Segment> segments;
+			Digests digests;
+
+			std::mutex lock;
+			std::condition_variable idle;
+			size_t running = 0;
+
+			template <typename F>
+			void run(F &&func);
+			void wait();
+	};
+};
+
+#endif /* __HASHED_IMAGE_HPP__ */
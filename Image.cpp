@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Copyright(c) 2023 Koko Software. All rights reserved.
+//
+// Author: Adrian Warecki <embedded@kokosoftware.pl>
+
+#include "types.hpp"
+#include "Image.hpp"
+
+#include <algorithm>
+
+using namespace elf;
+
+Image::Image(uint64_t base, size_t size)
+	: base(base), length(size), buffer(std::make_unique_for_overwrite<std::byte[]>(size))
+{
+}
+
+std::span<std::byte> Image::process(uint64_t address, size_t size) {
+	if (address < base || address - base > length || size > length - (address - base))
+		throw Exception("Segment outside of the image.");
+
+	const size_t offset = address - base;
+	ranges.emplace_back(offset, size);
+
+	return { buffer.get() + offset, size };
+}
+
+void Image::fill_gaps(std::byte fill) {
+	std::sort(ranges.begin(), ranges.end());
+
+	size_t pos = 0;
+	for (const auto &[offset, size] : ranges) {
+		if (offset > pos)
+			std::memset(buffer.get() + pos, std::to_integer<int>(fill), offset - pos);
+
+		pos = std::max(pos, offset + size);
+	}
+
+	if (pos < length)
+		std::memset(buffer.get() + pos, std::to_integer<int>(fill), length - pos);
+
+	// Whole image is initialized now
+	ranges.assign(1, { 0, length });
+}
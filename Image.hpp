@@ -0,0 +1,54 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright(c) 2023 Koko Software. All rights reserved.
+ *
+ * Author: Adrian Warecki <embedded@kokosoftware.pl>
+ */
+
+#ifndef __IMAGE_HPP__
+#define __IMAGE_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace elf {
+	// Destination of the loadable segments of an elf file
+	class ImageInterface {
+		public:
+			virtual ~ImageInterface() = default;
+
+			// Memory for size bytes of the image starting at address
+			virtual std::span<std::byte> process(uint64_t address, size_t size) = 0;
+			// Segment at address is fully written, data is the memory given by process()
+			virtual void complete(uint64_t /* address */, std::span<const std::byte> /* data */) {}
+	};
+
+	// Firmware image in a single buffer laid out by physical address
+	class Image : public ImageInterface {
+		public:
+			Image(uint64_t base, size_t size);
+
+			std::span<std::byte> process(uint64_t address, size_t size) override;
+
+			// Fill all bytes not handed out by process()
+			void fill_gaps(std::byte fill);
+
+			uint64_t get_base() const { return base; }
+			std::span<std::byte> data() { return { buffer.get(), length }; }
+			std::span<const std::byte> data() const { return { buffer.get(), length }; }
+
+		private:
+			uint64_t base;
+			size_t length;
+			// Left uninitialized, every byte is written by a segment or fill_gaps()
+			std::unique_ptr<std::byte[]> buffer;
+			// Offset and size of every range handed out
+			std::vector<std::pair<size_t, size_t>> ranges;
+	};
+};
+
+#endif /* __IMAGE_HPP__ */
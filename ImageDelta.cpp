@@ -0,0 +1,188 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Copyright(c) 2023 Koko Software. All rights reserved.
+//
+// Author: Adrian Warecki <embedded@kokosoftware.pl>
+
+#include "types.hpp"
+#include "ImageDelta.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+using namespace elf;
+
+namespace {
+	const char magic[8] = { 'E', 'L', 'F', 'D', 'E', 'L', 'T', 'A' };
+	const uint32_t version = 1;
+
+	// magic, version, page size, base, size, range count, digest
+	const size_t header_size = 8 + 4 + 4 + 8 + 8 + 8 + 32;
+	// address, size
+	const size_t range_size = 16;
+
+	template <typename T>
+	void put(std::vector<std::byte> &out, T value) {
+		for (size_t idx = 0; idx < sizeof(T); idx++, value >>= 8)
+			out.push_back(std::byte(value & 0xFF));
+	}
+
+	template <typename T>
+	T get(std::span<const std::byte> data, size_t offset) {
+		T value = 0;
+
+		for (size_t idx = sizeof(T); idx-- > 0;)
+			value = (value << 8) | std::to_integer<T>(data[offset + idx]);
+
+		return value;
+	}
+
+	// Part of the page inside the image
+	std::pair<uint64_t, uint64_t> clip(uint64_t page, size_t page_size, uint64_t base, uint64_t size) {
+		return { std::max(page * page_size, base), std::min((page + 1) * page_size, base + size) };
+	}
+}
+
+ImageDelta::PageHashes ImageDelta::hash_pages(const Image &image, size_t page_size) {
+	if (!page_size)
+		throw Exception("Invalid page size.");
+
+	const std::span<const std::byte> data = image.data();
+	PageHashes hashes = { image.get_base(), data.size(), page_size, {} };
+
+	if (data.empty())
+		return hashes;
+
+	const uint64_t first = image.get_base() / page_size;
+	const uint64_t last = (image.get_base() + data.size() - 1) / page_size;
+
+	hashes.pages.reserve(last - first + 1);
+	for (uint64_t page = first; page <= last; page++) {
+		const auto [begin, end] = clip(page, page_size, image.get_base(), data.size());
+		hashes.pages.push_back(Sha256::digest(data.subspan(begin - image.get_base(), end - begin)));
+	}
+
+	return hashes;
+}
+
+ImageDelta::ImageDelta(const PageHashes &from, Image &&to)
+	: image(std::move(to)), page_size(from.page_size)
+{
+	compare(from);
+}
+
+ImageDelta::ImageDelta(Elf &from, Elf &to, size_t page_size, std::byte fill)
+	: image(to.read_image(fill)), page_size(page_size)
+{
+	compare(hash_pages(from.read_image(fill), page_size));
+}
+
+void ImageDelta::compare(const PageHashes &from) {
+	const std::span<const std::byte> data = image.data();
+	const uint64_t base = image.get_base();
+
+	if (!page_size)
+		throw Exception("Invalid page size.");
+
+	if (data.empty())
+		return;
+
+	const uint64_t from_first = from.base / page_size;
+	const uint64_t first = base / page_size;
+	const uint64_t last = (base + data.size() - 1) / page_size;
+
+	for (uint64_t page = first; page <= last; page++) {
+		const auto [begin, end] = clip(page, page_size, base, data.size());
+		const std::span<const std::byte> content = data.subspan(begin - base, end - begin);
+
+		// Same page of the old image must cover the same addresses
+		bool same = false;
+		if (page >= from_first && page - from_first < from.pages.size() &&
+		    clip(page, page_size, from.base, from.size) == std::make_pair(begin, end))
+			same = Sha256::digest(content) == from.pages[page - from_first];
+
+		if (same)
+			continue;
+
+		// Extend the previous range when the pages are adjacent
+		if (!ranges.empty() && ranges.back().address + ranges.back().data.size() == begin)
+			ranges.back().data = { ranges.back().data.data(), ranges.back().data.size() + content.size() };
+		else
+			ranges.push_back({ begin, content });
+	}
+}
+
+size_t ImageDelta::size() const {
+	size_t total = 0;
+
+	for (const Range &range : ranges)
+		total += range.data.size();
+
+	return total;
+}
+
+std::vector<std::byte> ImageDelta::serialize() const {
+	std::vector<std::byte> out;
+	out.reserve(header_size + ranges.size() * range_size + size());
+
+	const auto *bytes = reinterpret_cast<const std::byte*>(magic);
+	out.insert(out.end(), bytes, bytes + sizeof(magic));
+	put<uint32_t>(out, version);
+	put<uint32_t>(out, static_cast<uint32_t>(page_size));
+	put<uint64_t>(out, image.get_base());
+	put<uint64_t>(out, image.data().size());
+	put<uint64_t>(out, ranges.size());
+
+	const Sha256::Digest digest = Sha256::digest(image.data());
+	out.insert(out.end(), digest.begin(), digest.end());
+
+	for (const Range &range : ranges) {
+		put<uint64_t>(out, range.address);
+		put<uint64_t>(out, range.data.size());
+	}
+
+	for (const Range &range : ranges)
+		out.insert(out.end(), range.data.begin(), range.data.end());
+
+	return out;
+}
+
+void ImageDelta::write(const std::filesystem::path &path) const {
+	const std::vector<std::byte> patch = serialize();
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+
+	out.write(reinterpret_cast<const char*>(patch.data()), patch.size());
+	if (!out)
+		throw String(_T("File write error."));
+}
+
+Sha256::Digest ImageDelta::apply(std::span<const std::byte> patch, ImageInterface &image) {
+	if (patch.size() < header_size || std::memcmp(patch.data(), magic, sizeof(magic)) ||
+	    get<uint32_t>(patch, 8) != version)
+		throw Exception("Invalid patch.");
+
+	const uint64_t count = get<uint64_t>(patch, 32);
+	if (count > (patch.size() - header_size) / range_size)
+		throw Exception("Invalid patch.");
+
+	Sha256::Digest digest;
+	std::memcpy(digest.data(), patch.data() + 40, digest.size());
+
+	size_t data = header_size + count * range_size;
+	for (uint64_t idx = 0; idx < count; idx++) {
+		const size_t entry = header_size + idx * range_size;
+		const uint64_t address = get<uint64_t>(patch, entry);
+		const uint64_t size = get<uint64_t>(patch, entry + 8);
+
+		if (size > patch.size() - data)
+			throw Exception("Invalid patch.");
+
+		const std::span<std::byte> target = image.process(address, size);
+		std::memcpy(target.data(), patch.data() + data, size);
+		image.complete(address, target);
+		data += size;
+	}
+
+	return digest;
+}
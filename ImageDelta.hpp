@@ -0,0 +1,71 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright(c) 2023 Koko Software. All rights reserved.
+ *
+ * Author: Adrian Warecki <embedded@kokosoftware.pl>
+ */
+
+#ifndef __IMAGE_DELTA_HPP__
+#define __IMAGE_DELTA_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+#include "Elf.hpp"
+#include "Image.hpp"
+#include "Sha.hpp"
+
+namespace elf {
+	// Changed parts of a firmware image for incremental flashing. Images are laid out by
+	// physical address and split into pages aligned to the page size. A page is changed
+	// when its SHA-256 differs from the old one, runs of changed pages form one range.
+	// The old image is only needed as page hashes, e.g. reported by the target.
+	class ImageDelta {
+		public:
+			static constexpr size_t default_page_size = 4096;
+
+			struct PageHashes {
+				uint64_t base;
+				uint64_t size;
+				size_t page_size;
+				// Pages from the one containing base, edge pages are clipped to the image
+				std::vector<Sha256::Digest> pages;
+			};
+
+			struct Range {
+				uint64_t address;
+				std::span<const std::byte> data;	// Points into the new image
+			};
+
+			static PageHashes hash_pages(const Image &image, size_t page_size = default_page_size);
+
+			ImageDelta(const PageHashes &from, Image &&to);
+			// Gaps between segments are filled on both sides, e.g. with erased flash value
+			ImageDelta(Elf &from, Elf &to, size_t page_size = default_page_size, std::byte fill = std::byte(0xFF));
+
+			const std::vector<Range> &get_ranges() const { return ranges; }
+			// Bytes of changed data
+			size_t size() const;
+			const Image &get_image() const { return image; }
+
+			// Patch: header with the SHA-256 of the whole new image, range table, data.
+			// All fields are little endian.
+			std::vector<std::byte> serialize() const;
+			void write(const std::filesystem::path &path) const;
+
+			// Write the ranges of a patch to the image, returns the digest of the new image
+			static Sha256::Digest apply(std::span<const std::byte> patch, ImageInterface &image);
+
+		private:
+			Image image;
+			size_t page_size;
+			std::vector<Range> ranges;
+
+			void compare(const PageHashes &from);
+	};
+};
+
+#endif /* __IMAGE_DELTA_HPP__ */
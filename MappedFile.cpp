@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Copyright(c) 2023 Koko Software. All rights reserved.
+//
+// Author: Adrian Warecki <embedded@kokosoftware.pl>
+
+#include "types.hpp"
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+using namespace elf;
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::filesystem::path &path)
+	: base(nullptr), length(0), file(INVALID_HANDLE_VALUE), mapping(nullptr)
+{
+	file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+			   OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		throw Exception("File open error.");
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size)) {
+		CloseHandle(file);
+		throw Exception("File open error.");
+	}
+
+	length = static_cast<size_t>(file_size.QuadPart);
+
+	// Empty file cannot be mapped
+	if (!length)
+		return;
+
+	mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping)
+		base = static_cast<const std::byte *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+
+	if (!base) {
+		if (mapping)
+			CloseHandle(mapping);
+		CloseHandle(file);
+		throw Exception("File mapping error.");
+	}
+}
+
+MappedFile::~MappedFile() {
+	if (base)
+		UnmapViewOfFile(base);
+	if (mapping)
+		CloseHandle(mapping);
+	CloseHandle(file);
+}
+#else
+MappedFile::MappedFile(const std::filesystem::path &path)
+	: base(nullptr), length(0)
+{
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		throw Exception("File open error.");
+
+	struct stat st;
+	if (fstat(fd, &st)) {
+		close(fd);
+		throw Exception("File open error.");
+	}
+
+	length = static_cast<size_t>(st.st_size);
+
+	// Empty file cannot be mapped
+	if (length) {
+		void *addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (addr == MAP_FAILED) {
+			close(fd);
+			throw Exception("File mapping error.");
+		}
+
+		base = static_cast<const std::byte *>(addr);
+	}
+
+	// Mapping stays valid after the descriptor is closed
+	close(fd);
+}
+
+MappedFile::~MappedFile() {
+	if (base)
+		munmap(const_cast<std::byte *>(base), length);
+}
+#endif
@@ -0,0 +1,39 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright(c) 2023 Koko Software. All rights reserved.
+ *
+ * Author: Adrian Warecki <embedded@kokosoftware.pl>
+ */
+
+#ifndef __MAPPED_FILE_HPP__
+#define __MAPPED_FILE_HPP__
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+
+namespace elf {
+	// Read-only view of a whole file mapped into the address space.
+	// Pages are brought in by the OS on first access.
+	class MappedFile {
+		public:
+			MappedFile(const std::filesystem::path &path);
+			~MappedFile();
+
+			MappedFile(const MappedFile &) = delete;
+			MappedFile &operator=(const MappedFile &) = delete;
+
+			std::span<const std::byte> data() const { return { base, length }; }
+			size_t size() const { return length; }
+
+		private:
+			const std::byte *base;
+			size_t length;
+#ifdef _WIN32
+			void *file;
+			void *mapping;
+#endif
+	};
+};
+
+#endif /* __MAPPED_FILE_HPP__ */
@@ -0,0 +1,129 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Copyright(c) 2023 Koko Software. All rights reserved.
+//
+// Author: Adrian Warecki <embedded@kokosoftware.pl>
+
+#include "types.hpp"
+#include "NameIndex.hpp"
+
+using namespace elf;
+
+NameIndex::NameIndex(std::pmr::memory_resource *resource)
+	: slots(resource), keys(resource), chain(resource)
+{
+}
+
+uint32_t NameIndex::hash(std::string_view name) {
+	uint32_t h = 5381;
+
+	for (unsigned char c : name)
+		h = h * 33 + c;
+
+	return h;
+}
+
+// Fibonacci hashing, djb hash has weak low bits
+uint32_t NameIndex::position(uint32_t hash) const {
+	return (hash * 0x9E3779B1u) >> shift;
+}
+
+void NameIndex::clear() {
+	slots.clear();
+	keys.clear();
+	chain.clear();
+	mask = 0;
+	shift = 32;
+}
+
+void NameIndex::build(std::pmr::vector<std::string_view> &&names) {
+	keys = std::move(names);
+	chain.assign(keys.size(), npos);
+
+	// Keep load factor at most 50%
+	unsigned int bits = min_bits;
+	while ((size_t(1) << bits) < keys.size() * 2)
+		bits++;
+
+	const size_t capacity = size_t(1) << bits;
+	mask = static_cast<uint32_t>(capacity - 1);
+	shift = 32 - bits;
+	slots.assign(capacity, { 0, npos });
+
+	// Insert in reverse order, so prepending builds ascending chains
+	for (size_t idx = keys.size(); idx-- > 0;) {
+		if (keys[idx].empty())
+			continue;
+
+		const uint32_t h = hash(keys[idx]);
+		uint32_t pos = position(h);
+
+		while (slots[pos].index != npos) {
+			if (slots[pos].hash == h && keys[slots[pos].index] == keys[idx])
+				break;
+
+			pos = (pos + 1) & mask;
+		}
+
+		chain[idx] = slots[pos].index;
+		slots[pos] = { h, static_cast<uint32_t>(idx) };
+	}
+}
+
+// Layout: bits, key count, slots as hash and index pairs, chain
+void NameIndex::save(std::vector<uint32_t> &out) const {
+	out.push_back(32 - shift);
+	out.push_back(static_cast<uint32_t>(keys.size()));
+
+	for (const Slot &slot : slots) {
+		out.push_back(slot.hash);
+		out.push_back(slot.index);
+	}
+
+	out.insert(out.end(), chain.begin(), chain.end());
+}
+
+void NameIndex::load(std::pmr::vector<std::string_view> &&names, std::span<const uint32_t> data) {
+	if (data.size() < 2 || data[0] < min_bits || data[0] > 31 || data[1] != names.size())
+		throw Exception("Invalid name index.");
+
+	const size_t capacity = size_t(1) << data[0];
+	if (capacity < names.size() * 2 || data.size() != 2 + capacity * 2 + names.size())
+		throw Exception("Invalid name index.");
+
+	keys = std::move(names);
+	mask = static_cast<uint32_t>(capacity - 1);
+	shift = 32 - data[0];
+
+	// Lookups stop at an empty slot, build() leaves at least half of them empty
+	size_t used = 0;
+	slots.resize(capacity);
+	for (size_t idx = 0; idx < capacity; idx++) {
+		slots[idx] = { data[2 + idx * 2], data[3 + idx * 2] };
+		if (slots[idx].index != npos && (slots[idx].index >= keys.size() || ++used > capacity / 2))
+			throw Exception("Invalid name index.");
+	}
+
+	// Chains ascend, so none is longer than the key count and none loops
+	chain.assign(data.begin() + 2 + capacity * 2, data.end());
+	for (size_t idx = 0; idx < chain.size(); idx++)
+		if (chain[idx] != npos && (chain[idx] >= keys.size() || chain[idx] <= idx))
+			throw Exception("Invalid name index.");
+}
+
+uint32_t NameIndex::find(std::string_view name) const {
+	if (slots.empty())
+		return npos;
+
+	const uint32_t h = hash(name);
+	uint32_t pos = position(h);
+
+	while (slots[pos].index != npos) {
+		if (slots[pos].hash == h && keys[slots[pos].index] == name)
+			return slots[pos].index;
+
+		pos = (pos + 1) & mask;
+	}
+
+	return npos;
+}
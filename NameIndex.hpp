@@ -0,0 +1,66 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright(c) 2023 Koko Software. All rights reserved.
+ *
+ * Author: Adrian Warecki <embedded@kokosoftware.pl>
+ */
+
+#ifndef __NAME_INDEX_HPP__
+#define __NAME_INDEX_HPP__
+
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace elf {
+	// Open addressing hash index over names of table entries. Names are kept as
+	// string_views into the string table, so lookups do not allocate. Entries
+	// sharing the same name are chained in ascending index order.
+	class NameIndex {
+		public:
+			static constexpr uint32_t npos = UINT32_MAX;
+
+			NameIndex(std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+
+			// GNU symbol hash function (the same as used by .gnu.hash)
+			static uint32_t hash(std::string_view name);
+
+			// Memory of the index, names given to build() and load() should use it too
+			std::pmr::memory_resource *resource() const { return chain.get_allocator().resource(); }
+
+			// Entries with empty names are not indexed
+			void build(std::pmr::vector<std::string_view> &&names);
+			void clear();
+			bool empty() const { return slots.empty(); }
+
+			// Flat copy of the index for persistent caches. Keys are not stored,
+			// load() must be given the same names the index was built from.
+			void save(std::vector<uint32_t> &out) const;
+			void load(std::pmr::vector<std::string_view> &&names, std::span<const uint32_t> data);
+
+			// Index of the first entry with the given name or npos
+			uint32_t find(std::string_view name) const;
+			// Index of the next entry with the same name or npos
+			uint32_t next(uint32_t index) const { return chain[index]; }
+
+		private:
+			static constexpr unsigned int min_bits = 4;
+
+			struct Slot {
+				uint32_t hash;
+				uint32_t index;
+			};
+
+			std::pmr::vector<Slot> slots;
+			std::pmr::vector<std::string_view> keys;
+			std::pmr::vector<uint32_t> chain;
+			uint32_t mask = 0;
+			unsigned int shift = 32;
+
+			uint32_t position(uint32_t hash) const;
+	};
+};
+
+#endif /* __NAME_INDEX_HPP__ */
@@ -0,0 +1,139 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Copyright(c) 2023 Koko Software. All rights reserved.
+//
+// Author: Adrian Warecki <embedded@kokosoftware.pl>
+
+#include "types.hpp"
+#include "PositionalFile.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#endif
+
+using namespace elf;
+
+#ifdef _WIN32
+PositionalFile::PositionalFile(const std::filesystem::path &path)
+	: length(0), file(INVALID_HANDLE_VALUE)
+{
+	file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+			   OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		throw Exception("File open error.");
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size)) {
+		CloseHandle(file);
+		throw Exception("File open error.");
+	}
+
+	length = static_cast<uint64_t>(file_size.QuadPart);
+}
+
+PositionalFile::~PositionalFile() {
+	CloseHandle(file);
+}
+
+// The offset is given with every call, the handle position is never relied on
+void PositionalFile::read(void *buf, size_t size, uint64_t offset) const {
+	auto *dst = static_cast<unsigned char*>(buf);
+
+	while (size) {
+		OVERLAPPED overlapped = {};
+		overlapped.Offset = static_cast<DWORD>(offset);
+		overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+		DWORD done = 0;
+		const DWORD chunk = static_cast<DWORD>(std::min<size_t>(size, 0x40000000));
+		if (!ReadFile(file, dst, chunk, &done, &overlapped) || !done)
+			throw Exception("File read error.");
+
+		dst += done;
+		offset += done;
+		size -= done;
+	}
+}
+
+void PositionalFile::read(std::span<const std::span<std::byte>> buffers, uint64_t offset) const {
+	for (const std::span<std::byte> &buffer : buffers) {
+		read(buffer.data(), buffer.size(), offset);
+		offset += buffer.size();
+	}
+}
+#else
+PositionalFile::PositionalFile(const std::filesystem::path &path)
+	: length(0)
+{
+	fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		throw Exception("File open error.");
+
+	struct stat st;
+	if (fstat(fd, &st)) {
+		close(fd);
+		throw Exception("File open error.");
+	}
+
+	length = static_cast<uint64_t>(st.st_size);
+}
+
+PositionalFile::~PositionalFile() {
+	close(fd);
+}
+
+void PositionalFile::read(void *buf, size_t size, uint64_t offset) const {
+	auto *dst = static_cast<unsigned char*>(buf);
+
+	while (size) {
+		const ssize_t done = pread(fd, dst, size, static_cast<off_t>(offset));
+		if (done < 0 && errno == EINTR)
+			continue;
+		if (done <= 0)
+			throw Exception("File read error.");
+
+		dst += done;
+		offset += done;
+		size -= done;
+	}
+}
+
+void PositionalFile::read(std::span<const std::span<std::byte>> buffers, uint64_t offset) const {
+	std::vector<iovec> vectors;
+
+	for (const std::span<std::byte> &buffer : buffers)
+		if (!buffer.empty())
+			vectors.push_back({ buffer.data(), buffer.size() });
+
+	size_t first = 0;
+	while (first < vectors.size()) {
+		const int count = static_cast<int>(std::min<size_t>(vectors.size() - first, IOV_MAX));
+		ssize_t done = preadv(fd, vectors.data() + first, count, static_cast<off_t>(offset));
+		if (done < 0 && errno == EINTR)
+			continue;
+		if (done <= 0)
+			throw Exception("File read error.");
+
+		offset += done;
+
+		// Skip what was read, a partially filled buffer is continued by the next call
+		while (first < vectors.size() && size_t(done) >= vectors[first].iov_len)
+			done -= vectors[first++].iov_len;
+
+		if (done) {
+			vectors[first].iov_base = static_cast<char*>(vectors[first].iov_base) + done;
+			vectors[first].iov_len -= done;
+		}
+	}
+}
+#endif
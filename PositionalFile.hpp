@@ -0,0 +1,46 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright(c) 2023 Koko Software. All rights reserved.
+ *
+ * Author: Adrian Warecki <embedded@kokosoftware.pl>
+ */
+
+#ifndef __POSITIONAL_FILE_HPP__
+#define __POSITIONAL_FILE_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+
+namespace elf {
+	// Read-only file accessed by positional reads (pread / preadv). There is no shared
+	// file position, so any number of threads may read at once.
+	class PositionalFile {
+		public:
+			PositionalFile(const std::filesystem::path &path);
+			~PositionalFile();
+
+			PositionalFile(const PositionalFile &) = delete;
+			PositionalFile &operator=(const PositionalFile &) = delete;
+
+			uint64_t size() const { return length; }
+
+			// Read exactly size bytes at offset, throws on a short read
+			void read(void *buf, size_t size, uint64_t offset) const;
+			// Read consecutive bytes at offset into the buffers with a single vectored read
+			void read(std::span<const std::span<std::byte>> buffers, uint64_t offset) const;
+
+		private:
+			uint64_t length;
+#ifdef _WIN32
+			void *file;
+#else
+			int fd;
+#endif
+
+			friend class AsyncReader;
+	};
+};
+
+#endif /* __POSITIONAL_FILE_HPP__ */
@@ -0,0 +1,220 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Copyright(c) 2023 Koko Software. All rights reserved.
+//
+// Author: Adrian Warecki <embedded@kokosoftware.pl>
+
+#include "types.hpp"
+#include "Relocation.hpp"
+#include "ElfTraits.hpp"
+
+#include <algorithm>
+
+using namespace elf;
+
+void RelocationTypes::add(uint16_t machine, uint8_t type, Handler handler) {
+	machines[machine][type] = handler;
+}
+
+RelocationTypes::Handler RelocationTypes::find(uint16_t machine, uint8_t type) const {
+	const auto it = machines.find(machine);
+	return it != machines.end() ? it->second[type] : nullptr;
+}
+
+const RelocationTypes &RelocationTypes::builtin() {
+	static const RelocationTypes types = [] {
+		RelocationTypes types;
+		add_xtensa_relocations(types);
+		add_i386_relocations(types);
+		return types;
+	}();
+
+	return types;
+}
+
+Relocator::Relocator(Elf &elf, const RelocationTypes &types)
+	: elf(elf), types(types)
+{
+	if (elf.get_class() != ELFCLASS32 || elf.get_byte_order() != ByteOrder<std::endian::native>::data)
+		throw Exception("Relocation requires an ELF32 file in host byte order.");
+}
+
+// Sections of relocatable files are linked at address zero
+uint32_t Relocator::link_address(unsigned int index) const {
+	return elf.get_file_header().type == ET_REL ? 0 : static_cast<uint32_t>(elf.get_sections()[index].addr);
+}
+
+size_t Relocator::find_range(uint32_t address) const {
+	auto it = std::upper_bound(ranges.begin(), ranges.end(), address,
+				   [](uint32_t addr, const Range &range) { return addr < range.start; });
+
+	if (it == ranges.begin())
+		throw Exception("Address outside of the loaded sections.");
+
+	// End of a section is a valid address too
+	--it;
+	if (address - it->start > it->size)
+		throw Exception("Address outside of the loaded sections.");
+
+	return it - ranges.begin();
+}
+
+uint32_t Relocator::translate(uint32_t address) const {
+	const Range &range = ranges[find_range(address)];
+	return range.address + (address - range.start);
+}
+
+uint32_t Relocator::resolve(const SymbolTable &symtab, const Elf32_Sym &sym) const {
+	if (sym.shndx == SHN_ABS)
+		return sym.value;
+
+	if (sym.shndx == SHN_UNDEF) {
+		if (!sym.name)
+			return 0;
+
+		const std::string_view name = symtab.get_strings().get(sym.name);
+		uint32_t value;
+		if (resolver && resolver(name, value))
+			return value;
+
+		if (ELF32_ST_BIND(sym.info) == STB_WEAK)
+			return 0;
+
+		throw Exception("Unresolved symbol " + std::string(name) + ".");
+	}
+
+	if (sym.shndx >= placement.size() || placement[sym.shndx].data.empty())
+		throw Exception("Symbol defined in a section that is not loaded.");
+
+	return placement[sym.shndx].address + (sym.value - link_address(sym.shndx));
+}
+
+void Relocator::relocate(std::span<const SectionPlacement> placement) {
+	const std::vector<SectionHeader> &sections = elf.get_sections();
+
+	this->placement = placement;
+	ranges.clear();
+	for (unsigned int i = 0; i < std::min(placement.size(), sections.size()); i++) {
+		if (!placement[i].data.empty())
+			ranges.push_back({ link_address(i), static_cast<uint32_t>(placement[i].data.size()),
+					   placement[i].address, i });
+	}
+	std::sort(ranges.begin(), ranges.end(), [](const Range &a, const Range &b) { return a.start < b.start; });
+
+	if (ranges.empty())
+		return;
+
+	section_ranges.assign(placement.size(), static_cast<uint32_t>(ranges.size()));
+	for (size_t i = 0; i < ranges.size(); i++)
+		section_ranges[ranges[i].section] = static_cast<uint32_t>(i);
+
+	// Relocation sections usually share one symbol table
+	std::unordered_map<unsigned int, Symbols> symbols;
+
+	for (unsigned int i = 0; i < sections.size(); i++) {
+		const SectionHeader &header = sections[i];
+
+		if (header.type != SHT_REL && header.type != SHT_RELA)
+			continue;
+
+		// Dynamic relocations of executables and shared objects refer to any section
+		if (header.info) {
+			if (header.info >= placement.size() || placement[header.info].data.empty())
+				continue;
+		} else if (elf.get_file_header().type == ET_REL) {
+			continue;
+		}
+
+		auto [it, inserted] = symbols.try_emplace(static_cast<unsigned int>(header.link));
+		if (inserted && header.link) {
+			elf.read_symbols(it->second.table, static_cast<unsigned int>(header.link));
+			it->second.values.resize(it->second.table.symbols().size());
+			it->second.resolved.resize(it->second.table.symbols().size());
+		}
+
+		apply(i, it->second);
+	}
+}
+
+void Relocator::apply(unsigned int index, Symbols &symbols) {
+	const SectionHeader &header = elf.get_sections()[index];
+	const bool rela = header.type == SHT_RELA;
+	const size_t entsize = rela ? sizeof(Elf32_Rela) : sizeof(Elf32_Rel);
+	const uint16_t machine = elf.get_file_header().machine;
+	const std::span<const Elf32_Sym> syms = symbols.table.symbols();
+
+	if (header.entsize && header.entsize != entsize)
+		throw Exception("Invalid relocation entry size.");
+
+	Section table;
+	elf.read_section(table, index);
+	const std::byte *entries = table.data().data();
+	const size_t count = table.data().size() / entsize;
+
+	// All entries patch the same section if it is specified, they are grouped by type only.
+	// Dynamic relocations are grouped by the target range and type.
+	const size_t fixed = header.info ? section_ranges[header.info] : ranges.size();
+	const bool grouped = fixed == ranges.size();
+
+	std::vector<uint32_t> keys(count);
+	size_t last = 0;
+	for (size_t i = 0; i < count; i++) {
+		const Elf32_Rel *rel = reinterpret_cast<const Elf32_Rel*>(entries + i * entsize);
+		size_t range = 0;
+
+		if (grouped) {
+			// Consecutive entries mostly patch the same section
+			range = last;
+			if (rel->off < ranges[range].start || rel->off - ranges[range].start >= ranges[range].size)
+				range = last = find_range(rel->off);
+		}
+
+		keys[i] = static_cast<uint32_t>(range << 8 | ELF32_R_TYPE(rel->info));
+	}
+
+	// Counting sort of the entries by key, keeps the order within a group
+	std::vector<uint32_t> first(((grouped ? ranges.size() : 1) << 8) + 1);
+	for (const uint32_t key : keys)
+		first[key + 1]++;
+
+	for (size_t key = 0; key + 1 < first.size(); key++) {
+		if (first[key + 1] && !types.find(machine, key & 0xff))
+			throw Exception("Unsupported relocation type " + std::to_string(key & 0xff) + ".");
+		first[key + 1] += first[key];
+	}
+
+	std::vector<RelocationPatch> patches(count);
+	std::vector<uint32_t> next(first.begin(), first.end() - 1);
+
+	for (size_t i = 0; i < count; i++) {
+		const Elf32_Rela *rel = reinterpret_cast<const Elf32_Rela*>(entries + i * entsize);
+		const uint32_t sym = ELF32_R_SYM(rel->info);
+		const Range &range = ranges[grouped ? keys[i] >> 8 : fixed];
+
+		if (sym && sym >= syms.size())
+			throw Exception("Invalid relocation symbol index.");
+
+		// Each symbol is resolved on its first use only
+		if (sym && !symbols.resolved[sym]) {
+			symbols.values[sym] = resolve(symbols.table, syms[sym]);
+			symbols.resolved[sym] = true;
+		}
+
+		const uint32_t offset = rel->off - range.start;
+		if (offset >= range.size)
+			throw Exception("Relocation outside of the section.");
+
+		patches[next[keys[i]]++] = { offset, sym ? symbols.values[sym] : 0, rela ? rel->addend : 0 };
+	}
+
+	const std::span<const RelocationPatch> all(patches);
+	for (size_t key = 0; key + 1 < first.size(); key++) {
+		if (first[key] == first[key + 1])
+			continue;
+
+		const Range &range = ranges[grouped ? key >> 8 : fixed];
+		const RelocationBatch batch{ placement[range.section].data, range.address, rela,
+					     all.subspan(first[key], first[key + 1] - first[key]), *this };
+		types.find(machine, key & 0xff)(batch);
+	}
+}
@@ -0,0 +1,136 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright(c) 2023 Koko Software. All rights reserved.
+ *
+ * Author: Adrian Warecki <embedded@kokosoftware.pl>
+ */
+
+#ifndef __RELOCATION_HPP__
+#define __RELOCATION_HPP__
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "Elf.hpp"
+
+namespace elf {
+	class Relocator;
+
+	// Single relocation entry with its symbol already resolved
+	struct RelocationPatch {
+		uint32_t offset;	// Offset of the patched location in the target section
+		uint32_t value;		// Run time value of the symbol (S)
+		int32_t addend;		// Explicit addend (A), zero for SHT_REL entries
+	};
+
+	// All entries of one type applied to one target section
+	struct RelocationBatch {
+		std::span<std::byte> data;	// Target section content
+		uint32_t address;		// Run time address of the target section
+		bool rela;			// Addends are explicit, otherwise they are stored in data
+		std::span<const RelocationPatch> patches;
+		const Relocator &relocator;
+
+		// Unaligned access to the target section in host byte order
+		uint32_t read32(uint32_t offset) const {
+			uint32_t value;
+			std::memcpy(&value, at(offset, sizeof(value)), sizeof(value));
+			return value;
+		}
+
+		void write32(uint32_t offset, uint32_t value) const {
+			std::memcpy(at(offset, sizeof(value)), &value, sizeof(value));
+		}
+
+		// Explicit addend or the one stored at the patched location
+		int32_t addend(const RelocationPatch &patch) const {
+			return rela ? patch.addend : static_cast<int32_t>(read32(patch.offset));
+		}
+
+		std::byte *at(uint32_t offset, size_t size) const {
+			if (size > data.size() || offset > data.size() - size)
+				throw Exception("Relocation outside of the section.");
+			return data.data() + offset;
+		}
+	};
+
+	// Relocation handlers registered per machine and relocation type
+	class RelocationTypes {
+		public:
+			using Handler = void (*)(const RelocationBatch &batch);
+
+			void add(uint16_t machine, uint8_t type, Handler handler);
+			Handler find(uint16_t machine, uint8_t type) const;
+
+			// Handlers for all machines supported by the library
+			static const RelocationTypes &builtin();
+
+		private:
+			std::unordered_map<uint16_t, std::array<Handler, 256>> machines;
+	};
+
+	void add_xtensa_relocations(RelocationTypes &types);
+	void add_i386_relocations(RelocationTypes &types);
+
+	// Location of a section in the relocated image
+	struct SectionPlacement {
+		uint32_t address = 0;		// Run time address of the section
+		std::span<std::byte> data;	// Loaded content, empty if the section is not loaded
+	};
+
+	// Applies SHT_REL and SHT_RELA sections of an ELF32 file in host byte order
+	// to sections placed at arbitrary addresses.
+	class Relocator {
+		public:
+			// Value of an undefined symbol, returns false if it is unknown
+			using Resolver = std::function<bool(std::string_view name, uint32_t &value)>;
+
+			Relocator(Elf &elf, const RelocationTypes &types = RelocationTypes::builtin());
+
+			void set_resolver(Resolver resolver) { this->resolver = std::move(resolver); }
+
+			// Placement is indexed by section number. Only relocation sections
+			// targeting a loaded section are applied.
+			void relocate(std::span<const SectionPlacement> placement);
+
+			// Run time address of a link time address inside a loaded section
+			uint32_t translate(uint32_t address) const;
+
+		private:
+			Elf &elf;
+			const RelocationTypes &types;
+			Resolver resolver;
+
+			std::span<const SectionPlacement> placement;
+			// Link time ranges of loaded sections sorted by address
+			struct Range {
+				uint32_t start;
+				uint32_t size;
+				uint32_t address;
+				unsigned int section;
+			};
+			std::vector<Range> ranges;
+			// Index into ranges of every loaded section
+			std::vector<uint32_t> section_ranges;
+
+			// Symbol table with values resolved on the first use
+			struct Symbols {
+				SymbolTable table;
+				std::vector<uint32_t> values;
+				std::vector<bool> resolved;
+			};
+
+			uint32_t link_address(unsigned int index) const;
+			size_t find_range(uint32_t address) const;
+			uint32_t resolve(const SymbolTable &symtab, const Elf32_Sym &sym) const;
+			void apply(unsigned int index, Symbols &symbols);
+	};
+};
+
+#endif /* __RELOCATION_HPP__ */
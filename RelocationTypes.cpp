@@ -0,0 +1,198 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Copyright(c) 2023 Koko Software. All rights reserved.
+//
+// Author: Adrian Warecki <embedded@kokosoftware.pl>
+
+#include "types.hpp"
+#include "Relocation.hpp"
+
+using namespace elf;
+
+static void ignore(const RelocationBatch &) {
+}
+
+// Symbol value plus addend
+static void absolute(const RelocationBatch &batch) {
+	for (const RelocationPatch &patch : batch.patches)
+		batch.write32(patch.offset, patch.value + batch.addend(patch));
+}
+
+// Symbol value plus addend relative to the patched location
+static void pc_relative(const RelocationBatch &batch) {
+	for (const RelocationPatch &patch : batch.patches)
+		batch.write32(patch.offset, patch.value + batch.addend(patch) - (batch.address + patch.offset));
+}
+
+// Symbol value, implicit addends are ignored
+static void symbol(const RelocationBatch &batch) {
+	for (const RelocationPatch &patch : batch.patches)
+		batch.write32(patch.offset, patch.value + (batch.rela ? patch.addend : 0));
+}
+
+// Link time address moved to its run time location
+static void relative(const RelocationBatch &batch) {
+	for (const RelocationPatch &patch : batch.patches)
+		batch.write32(patch.offset, batch.relocator.translate(batch.addend(patch)));
+}
+
+// R_XTENSA_32 adds to the value stored at the location even with explicit addends
+static void xtensa_32(const RelocationBatch &batch) {
+	for (const RelocationPatch &patch : batch.patches)
+		batch.write32(patch.offset, batch.read32(patch.offset) + patch.value + patch.addend);
+}
+
+static void xtensa_relative(const RelocationBatch &batch) {
+	for (const RelocationPatch &patch : batch.patches)
+		batch.write32(patch.offset, batch.relocator.translate(batch.read32(patch.offset) + patch.addend));
+}
+
+static bool fits(int32_t value, unsigned int bits) {
+	return value >= -(1 << (bits - 1)) && value < (1 << (bits - 1));
+}
+
+// Field of bits bits wide at shift replaced by value
+static uint32_t insert(uint32_t insn, unsigned int shift, unsigned int bits, uint32_t value) {
+	const uint32_t mask = ((1u << bits) - 1) << shift;
+	return (insn & ~mask) | ((value << shift) & mask);
+}
+
+// Immediate operand of the instruction in slot 0, in little endian layout. L32R, calls,
+// jumps, branches and loops are patched. A PC relative target inside the same section
+// does not change when the section moves, other instructions are rejected.
+static void xtensa_slot0_op(const RelocationBatch &batch) {
+	for (const RelocationPatch &patch : batch.patches) {
+		// Opcodes 8 to 13 are 16 bit instructions of the code density option
+		const unsigned int op0 = std::to_integer<unsigned int>(*batch.at(patch.offset, 2)) & 0xf;
+		const size_t size = op0 >= 8 && op0 <= 13 ? 2 : 3;
+		std::byte *loc = batch.at(patch.offset, size);
+
+		const uint32_t pc = batch.address + patch.offset;
+		const uint32_t target = patch.value + patch.addend;
+		const int32_t branch = static_cast<int32_t>(target - pc - 4);
+		uint32_t insn = std::to_integer<uint32_t>(loc[0]) | std::to_integer<uint32_t>(loc[1]) << 8;
+		if (size == 3)
+			insn |= std::to_integer<uint32_t>(loc[2]) << 16;
+
+		int32_t diff;
+		unsigned int field = 0;	// Width of a signed PC relative offset ending at bit 23
+		bool supported = true;
+
+		switch (op0) {
+			case 1:	// L32R, literals precede the instruction
+				diff = static_cast<int32_t>(target - ((pc + 3) & ~3u));
+				if (diff >= 0 || !fits(diff, 18) || diff & 3)
+					throw Exception("L32R literal out of range.");
+				insn = insert(insn, 8, 16, static_cast<uint32_t>(diff >> 2));
+				break;
+
+			case 5:	// CALL0, CALL4, CALL8, CALL12
+				diff = static_cast<int32_t>(target - ((pc & ~3u) + 4));
+				if (!fits(diff, 20) || diff & 3)
+					throw Exception("CALL target out of range.");
+				insn = insert(insn, 6, 18, static_cast<uint32_t>(diff >> 2));
+				break;
+
+			case 6:
+				switch ((insn >> 4) & 3) {
+					case 0:	// J
+						field = 18;
+						break;
+
+					case 1:	// BEQZ, BNEZ, BLTZ, BGEZ
+						field = 12;
+						break;
+
+					case 2:	// BEQI, BNEI, BLTI, BGEI
+						field = 8;
+						break;
+
+					default:
+						if (((insn >> 6) & 3) >= 2) {	// BLTUI, BGEUI
+							field = 8;
+						} else if (((insn >> 6) & 3) == 1 && ((insn >> 12) & 0xf) <= 1) {	// BF, BT
+							field = 8;
+						} else if (((insn >> 6) & 3) == 1 && ((insn >> 12) & 0xf) >= 8 &&
+							   ((insn >> 12) & 0xf) <= 10) {	// LOOP, LOOPNEZ, LOOPGTZ
+							if (branch < 0 || branch > 0xff)
+								throw Exception("Loop end out of range.");
+							insn = insert(insn, 16, 8, static_cast<uint32_t>(branch));
+						} else {
+							supported = false;
+						}
+						break;
+				}
+				break;
+
+			case 7:	// Branches comparing two registers or testing a bit
+				field = 8;
+				break;
+
+			case 12:	// BEQZ.N, BNEZ.N branch forward only
+				if (!(insn & 0x80)) {
+					supported = false;
+					break;
+				}
+
+				if (branch < 0 || branch > 0x3f)
+					throw Exception("Branch target out of range.");
+				insn = insert(insn, 12, 4, static_cast<uint32_t>(branch));
+				insn = insert(insn, 4, 2, static_cast<uint32_t>(branch) >> 4);
+				break;
+
+			default:
+				supported = false;
+				break;
+		}
+
+		if (field) {
+			if (!fits(branch, field))
+				throw Exception("Branch target out of range.");
+			insn = insert(insn, 24 - field, field, static_cast<uint32_t>(branch));
+		}
+
+		if (!supported) {
+			if (target - batch.address < batch.data.size())
+				continue;
+
+			throw Exception("Unsupported Xtensa instruction relocation.");
+		}
+
+		loc[0] = std::byte(insn);
+		loc[1] = std::byte(insn >> 8);
+		if (size == 3)
+			loc[2] = std::byte(insn >> 16);
+	}
+}
+
+void elf::add_xtensa_relocations(RelocationTypes &types) {
+	types.add(EM_XTENSA, R_XTENSA_NONE, ignore);
+	types.add(EM_XTENSA, R_XTENSA_32, xtensa_32);
+	types.add(EM_XTENSA, R_XTENSA_RTLD, ignore);
+	types.add(EM_XTENSA, R_XTENSA_GLOB_DAT, symbol);
+	types.add(EM_XTENSA, R_XTENSA_JMP_SLOT, symbol);
+	types.add(EM_XTENSA, R_XTENSA_RELATIVE, xtensa_relative);
+	types.add(EM_XTENSA, R_XTENSA_PLT, symbol);
+	// Relaxation hints
+	types.add(EM_XTENSA, R_XTENSA_ASM_EXPAND, ignore);
+	types.add(EM_XTENSA, R_XTENSA_ASM_SIMPLIFY, ignore);
+	types.add(EM_XTENSA, R_XTENSA_32_PCREL, pc_relative);
+	types.add(EM_XTENSA, R_XTENSA_GNU_VTINHERIT, ignore);
+	types.add(EM_XTENSA, R_XTENSA_GNU_VTENTRY, ignore);
+	// Differences between labels do not change when a whole section is moved
+	types.add(EM_XTENSA, R_XTENSA_DIFF8, ignore);
+	types.add(EM_XTENSA, R_XTENSA_DIFF16, ignore);
+	types.add(EM_XTENSA, R_XTENSA_DIFF32, ignore);
+	types.add(EM_XTENSA, R_XTENSA_SLOT0_OP, xtensa_slot0_op);
+}
+
+void elf::add_i386_relocations(RelocationTypes &types) {
+	types.add(EM_386, R_386_NONE, ignore);
+	types.add(EM_386, R_386_32, absolute);
+	types.add(EM_386, R_386_PC32, pc_relative);
+	// Calls are bound directly to their targets
+	types.add(EM_386, R_386_PLT32, pc_relative);
+	types.add(EM_386, R_386_GLOB_DAT, symbol);
+	types.add(EM_386, R_386_JMP_SLOT, symbol);
+	types.add(EM_386, R_386_RELATIVE, relative);
+}
@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Copyright(c) 2023 Koko Software. All rights reserved.
+//
+// Author: Adrian Warecki <embedded@kokosoftware.pl>
+
+#include "types.hpp"
+#include "SectionCache.hpp"
+
+using namespace elf;
+
+SectionCache::SectionCache(size_t budget)
+	: budget(budget), used(0)
+{
+}
+
+void SectionCache::set_budget(size_t bytes) {
+	std::lock_guard<std::mutex> guard(lock);
+	budget = bytes;
+	evict(budget);
+}
+
+size_t SectionCache::get_budget() const {
+	std::lock_guard<std::mutex> guard(lock);
+	return budget;
+}
+
+size_t SectionCache::size() const {
+	std::lock_guard<std::mutex> guard(lock);
+	return used;
+}
+
+SectionCache::Buffer SectionCache::get(unsigned int index) {
+	std::lock_guard<std::mutex> guard(lock);
+	auto it = entries.find(index);
+	if (it == entries.end())
+		return nullptr;
+
+	lru.splice(lru.begin(), lru, it->second);
+	return it->second->buffer;
+}
+
+void SectionCache::put(unsigned int index, const Buffer &buffer, size_t size) {
+	std::lock_guard<std::mutex> guard(lock);
+
+	// Section larger than the whole budget is not worth evicting everything else
+	if (size > budget)
+		return;
+
+	auto it = entries.find(index);
+	if (it != entries.end()) {
+		used -= it->second->size;
+		lru.erase(it->second);
+		entries.erase(it);
+	}
+
+	evict(budget - size);
+
+	lru.push_front({ index, buffer, size });
+	entries[index] = lru.begin();
+	used += size;
+}
+
+void SectionCache::clear() {
+	std::lock_guard<std::mutex> guard(lock);
+	lru.clear();
+	entries.clear();
+	used = 0;
+}
+
+// Drop least recently used entries until at most limit bytes are used
+void SectionCache::evict(size_t limit) {
+	while (used > limit && !lru.empty()) {
+		used -= lru.back().size;
+		entries.erase(lru.back().index);
+		lru.pop_back();
+	}
+}
@@ -0,0 +1,57 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright(c) 2023 Koko Software. All rights reserved.
+ *
+ * Author: Adrian Warecki <embedded@kokosoftware.pl>
+ */
+
+#ifndef __SECTION_CACHE_HPP__
+#define __SECTION_CACHE_HPP__
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace elf {
+	// Section contents keyed by section index. Buffers are immutable and shared
+	// with the sections handed out, evicting an entry only drops the cache reference.
+	// Least recently used entries are evicted to stay within the byte budget.
+	// All operations are thread safe.
+	class SectionCache {
+		public:
+			using Buffer = std::shared_ptr<const unsigned char[]>;
+
+			static constexpr size_t default_budget = 64 * 1024 * 1024;
+
+			SectionCache(size_t budget = default_budget);
+
+			void set_budget(size_t bytes);
+			size_t get_budget() const;
+			size_t size() const;
+
+			// Cached buffer or nullptr, marks the entry as recently used
+			Buffer get(unsigned int index);
+			void put(unsigned int index, const Buffer &buffer, size_t size);
+			void clear();
+
+		private:
+			struct Entry {
+				unsigned int index;
+				Buffer buffer;
+				size_t size;
+			};
+
+			// Most recently used first
+			std::list<Entry> lru;
+			std::unordered_map<unsigned int, std::list<Entry>::iterator> entries;
+			size_t budget;
+			size_t used;
+			mutable std::mutex lock;
+
+			void evict(size_t limit);
+	};
+};
+
+#endif /* __SECTION_CACHE_HPP__ */
@@ -0,0 +1,330 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Copyright(c) 2023 Koko Software. All rights reserved.
+//
+// Author: Adrian Warecki <embedded@kokosoftware.pl>
+
+#include "types.hpp"
+#include "Sha.hpp"
+
+#include <bit>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SHA_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_SHA
+#else
+#include <cpuid.h>
+#define TARGET_SHA __attribute__((target("sha,sse4.1,ssse3")))
+#endif
+#endif
+
+using namespace elf;
+
+alignas(16) static const uint32_t k256[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static const uint64_t k512[80] = {
+	0x428a2f98d728ae22, 0x7137449123ef65cd, 0xb5c0fbcfec4d3b2f, 0xe9b5dba58189dbbc,
+	0x3956c25bf348b538, 0x59f111f1b605d019, 0x923f82a4af194f9b, 0xab1c5ed5da6d8118,
+	0xd807aa98a3030242, 0x12835b0145706fbe, 0x243185be4ee4b28c, 0x550c7dc3d5ffb4e2,
+	0x72be5d74f27b896f, 0x80deb1fe3b1696b1, 0x9bdc06a725c71235, 0xc19bf174cf692694,
+	0xe49b69c19ef14ad2, 0xefbe4786384f25e3, 0x0fc19dc68b8cd5b5, 0x240ca1cc77ac9c65,
+	0x2de92c6f592b0275, 0x4a7484aa6ea6e483, 0x5cb0a9dcbd41fbd4, 0x76f988da831153b5,
+	0x983e5152ee66dfab, 0xa831c66d2db43210, 0xb00327c898fb213f, 0xbf597fc7beef0ee4,
+	0xc6e00bf33da88fc2, 0xd5a79147930aa725, 0x06ca6351e003826f, 0x142929670a0e6e70,
+	0x27b70a8546d22ffc, 0x2e1b21385c26c926, 0x4d2c6dfc5ac42aed, 0x53380d139d95b3df,
+	0x650a73548baf63de, 0x766a0abb3c77b2a8, 0x81c2c92e47edaee6, 0x92722c851482353b,
+	0xa2bfe8a14cf10364, 0xa81a664bbc423001, 0xc24b8b70d0f89791, 0xc76c51a30654be30,
+	0xd192e819d6ef5218, 0xd69906245565a910, 0xf40e35855771202a, 0x106aa07032bbd1b8,
+	0x19a4c116b8d2d0c8, 0x1e376c085141ab53, 0x2748774cdf8eeb99, 0x34b0bcb5e19b48a8,
+	0x391c0cb3c5c95a63, 0x4ed8aa4ae3418acb, 0x5b9cca4f7763e373, 0x682e6ff3d6b2b8a3,
+	0x748f82ee5defb2fc, 0x78a5636f43172f60, 0x84c87814a1f0ab72, 0x8cc702081a6439ec,
+	0x90befffa23631e28, 0xa4506cebde82bde9, 0xbef9a3f7b2c67915, 0xc67178f2e372532b,
+	0xca273eceea26619c, 0xd186b8c721c0c207, 0xeada7dd6cde0eb1e, 0xf57d4f7fee6ed178,
+	0x06f067aa72176fba, 0x0a637dc5a2c898a6, 0x113f9804bef90dae, 0x1b710b35131c471b,
+	0x28db77f523047d84, 0x32caab7b40c72493, 0x3c9ebe0a15c9bebc, 0x431d67c49c100d4c,
+	0x4cc5d4becb3e42b6, 0x597f299cfc657e2a, 0x5fcb6fab3ad6faec, 0x6c44198c4a475817,
+};
+
+template <typename T>
+static T load_be(const std::byte *data) {
+	T value;
+	std::memcpy(&value, data, sizeof(value));
+
+	if constexpr (std::endian::native == std::endian::little) {
+		T out = 0;
+		for (size_t idx = 0; idx < sizeof(T); idx++, value >>= 8)
+			out = (out << 8) | (value & 0xFF);
+		return out;
+	}
+
+	return value;
+}
+
+template <typename T>
+static void store_be(std::byte *data, T value) {
+	for (size_t idx = sizeof(T); idx-- > 0; value >>= 8)
+		data[idx] = std::byte(value & 0xFF);
+}
+
+static void compress256_scalar(uint32_t state[8], const std::byte *data, size_t count) {
+	for (; count--; data += Sha256Engine::block_size) {
+		uint32_t w[64];
+
+		for (int t = 0; t < 16; t++)
+			w[t] = load_be<uint32_t>(data + t * 4);
+
+		for (int t = 16; t < 64; t++) {
+			const uint32_t s0 = std::rotr(w[t - 15], 7) ^ std::rotr(w[t - 15], 18) ^ (w[t - 15] >> 3);
+			const uint32_t s1 = std::rotr(w[t - 2], 17) ^ std::rotr(w[t - 2], 19) ^ (w[t - 2] >> 10);
+			w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+		}
+
+		uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+		uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+		for (int t = 0; t < 64; t++) {
+			const uint32_t t1 = h + (std::rotr(e, 6) ^ std::rotr(e, 11) ^ std::rotr(e, 25)) +
+					    ((e & f) ^ (~e & g)) + k256[t] + w[t];
+			const uint32_t t2 = (std::rotr(a, 2) ^ std::rotr(a, 13) ^ std::rotr(a, 22)) +
+					    ((a & b) ^ (a & c) ^ (b & c));
+			h = g; g = f; f = e; e = d + t1;
+			d = c; c = b; b = a; a = t1 + t2;
+		}
+
+		state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+		state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+	}
+}
+
+#ifdef SHA_X86
+// Four rounds per step, the message schedule is kept in four registers
+TARGET_SHA
+static void compress256_shani(uint32_t state[8], const std::byte *data, size_t count) {
+	const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+	// Instructions work on ABEF and CDGH register pairs
+	__m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[0])), 0xB1);
+	__m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[4])), 0x1B);
+	__m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+	state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+	for (; count--; data += Sha256Engine::block_size) {
+		const __m128i abef = state0;
+		const __m128i cdgh = state1;
+		__m128i msg[4];
+
+		for (int step = 0; step < 16; step++) {
+			__m128i w;
+
+			if (step < 4) {
+				w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + step * 16));
+				w = _mm_shuffle_epi8(w, mask);
+			} else {
+				w = _mm_sha256msg1_epu32(msg[step % 4], msg[(step + 1) % 4]);
+				w = _mm_add_epi32(w, _mm_alignr_epi8(msg[(step + 3) % 4], msg[(step + 2) % 4], 4));
+				w = _mm_sha256msg2_epu32(w, msg[(step + 3) % 4]);
+			}
+
+			msg[step % 4] = w;
+
+			tmp = _mm_add_epi32(w, _mm_load_si128(reinterpret_cast<const __m128i*>(&k256[step * 4])));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, tmp);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(tmp, 0x0E));
+		}
+
+		state0 = _mm_add_epi32(state0, abef);
+		state1 = _mm_add_epi32(state1, cdgh);
+	}
+
+	tmp = _mm_shuffle_epi32(state0, 0x1B);
+	state1 = _mm_shuffle_epi32(state1, 0xB1);
+	state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+	state1 = _mm_alignr_epi8(state1, tmp, 8);
+
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(&state[0]), state0);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(&state[4]), state1);
+}
+
+static bool has_sha() {
+	int info[4];
+
+#ifdef _MSC_VER
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	__cpuid(info, 1);
+	const int ecx = info[2];
+	__cpuidex(info, 7, 0);
+#else
+	unsigned int regs[4];
+
+	if (!__get_cpuid_count(7, 0, &regs[0], &regs[1], &regs[2], &regs[3]))
+		return false;
+	info[1] = static_cast<int>(regs[1]);
+
+	__get_cpuid(1, &regs[0], &regs[1], &regs[2], &regs[3]);
+	const int ecx = static_cast<int>(regs[2]);
+#endif
+
+	// SHA, SSE4.1 and SSSE3
+	return (info[1] & (1 << 29)) && (ecx & (1 << 19)) && (ecx & (1 << 9));
+}
+#endif
+
+void Sha256Engine::init() {
+	static const uint32_t initial[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+	};
+
+	std::memcpy(state, initial, sizeof(state));
+}
+
+void Sha256Engine::compress(const std::byte *blocks, size_t count) {
+#ifdef SHA_X86
+	static const bool shani = has_sha();
+
+	if (shani) {
+		compress256_shani(state, blocks, count);
+		return;
+	}
+#endif
+	compress256_scalar(state, blocks, count);
+}
+
+void Sha256Engine::store(std::byte *digest) const {
+	for (size_t idx = 0; idx < 8; idx++)
+		store_be(digest + idx * 4, state[idx]);
+}
+
+void Sha384Engine::init() {
+	static const uint64_t initial[8] = {
+		0xcbbb9d5dc1059ed8, 0x629a292a367cd507, 0x9159015a3070dd17, 0x152fecd8f70e5939,
+		0x67332667ffc00b31, 0x8eb44a8768581511, 0xdb0c2e0d64f98fa7, 0x47b5481dbefa4fa4,
+	};
+
+	std::memcpy(state, initial, sizeof(state));
+}
+
+void Sha384Engine::compress(const std::byte *data, size_t count) {
+	for (; count--; data += block_size) {
+		uint64_t w[80];
+
+		for (int t = 0; t < 16; t++)
+			w[t] = load_be<uint64_t>(data + t * 8);
+
+		for (int t = 16; t < 80; t++) {
+			const uint64_t s0 = std::rotr(w[t - 15], 1) ^ std::rotr(w[t - 15], 8) ^ (w[t - 15] >> 7);
+			const uint64_t s1 = std::rotr(w[t - 2], 19) ^ std::rotr(w[t - 2], 61) ^ (w[t - 2] >> 6);
+			w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+		}
+
+		uint64_t a = state[0], b = state[1], c = state[2], d = state[3];
+		uint64_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+		for (int t = 0; t < 80; t++) {
+			const uint64_t t1 = h + (std::rotr(e, 14) ^ std::rotr(e, 18) ^ std::rotr(e, 41)) +
+					    ((e & f) ^ (~e & g)) + k512[t] + w[t];
+			const uint64_t t2 = (std::rotr(a, 28) ^ std::rotr(a, 34) ^ std::rotr(a, 39)) +
+					    ((a & b) ^ (a & c) ^ (b & c));
+			h = g; g = f; f = e; e = d + t1;
+			d = c; c = b; b = a; a = t1 + t2;
+		}
+
+		state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+		state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+	}
+}
+
+void Sha384Engine::store(std::byte *digest) const {
+	for (size_t idx = 0; idx < 6; idx++)
+		store_be(digest + idx * 8, state[idx]);
+}
+
+template <typename Engine>
+Sha<Engine>::Sha() {
+	engine.init();
+}
+
+template <typename Engine>
+void Sha<Engine>::update(std::span<const std::byte> data) {
+	length += data.size();
+
+	if (buffered) {
+		const size_t count = std::min(data.size(), Engine::block_size - buffered);
+		std::memcpy(buffer.data() + buffered, data.data(), count);
+		buffered += count;
+		data = data.subspan(count);
+
+		if (buffered < Engine::block_size)
+			return;
+
+		engine.compress(buffer.data(), 1);
+		buffered = 0;
+	}
+
+	// Whole blocks are hashed in place
+	const size_t blocks = data.size() / Engine::block_size;
+	if (blocks)
+		engine.compress(data.data(), blocks);
+
+	data = data.subspan(blocks * Engine::block_size);
+	std::memcpy(buffer.data(), data.data(), data.size());
+	buffered = data.size();
+}
+
+// Padding bit, zeros and the message length in bits, big endian
+template <typename Engine>
+typename Sha<Engine>::Digest Sha<Engine>::finish() {
+	buffer[buffered++] = std::byte(0x80);
+
+	if (buffered > Engine::block_size - Engine::length_size) {
+		std::memset(buffer.data() + buffered, 0, Engine::block_size - buffered);
+		engine.compress(buffer.data(), 1);
+		buffered = 0;
+	}
+
+	std::memset(buffer.data() + buffered, 0, Engine::block_size - buffered);
+	store_be(buffer.data() + Engine::block_size - 8, length * 8);
+	engine.compress(buffer.data(), 1);
+
+	Digest digest;
+	engine.store(digest.data());
+	return digest;
+}
+
+template <typename Engine>
+typename Sha<Engine>::Digest Sha<Engine>::digest(std::span<const std::byte> data) {
+	Sha sha;
+	sha.update(data);
+	return sha.finish();
+}
+
+template class elf::Sha<Sha256Engine>;
+template class elf::Sha<Sha384Engine>;
+
+std::string elf::to_hex(std::span<const std::byte> digest) {
+	static const char digits[] = "0123456789abcdef";
+	std::string out;
+
+	out.reserve(digest.size() * 2);
+	for (std::byte value : digest) {
+		out += digits[std::to_integer<unsigned int>(value) >> 4];
+		out += digits[std::to_integer<unsigned int>(value) & 0xF];
+	}
+
+	return out;
+}
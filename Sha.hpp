@@ -0,0 +1,71 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright(c) 2023 Koko Software. All rights reserved.
+ *
+ * Author: Adrian Warecki <embedded@kokosoftware.pl>
+ */
+
+#ifndef __SHA_HPP__
+#define __SHA_HPP__
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace elf {
+	// SHA-256 compression, uses SHA-NI when the processor has it
+	struct Sha256Engine {
+		static constexpr size_t block_size = 64;
+		static constexpr size_t digest_size = 32;
+		static constexpr size_t length_size = 8;
+
+		uint32_t state[8];
+
+		void init();
+		void compress(const std::byte *blocks, size_t count);
+		void store(std::byte *digest) const;
+	};
+
+	// SHA-512 compression with the SHA-384 initial state and truncated digest
+	struct Sha384Engine {
+		static constexpr size_t block_size = 128;
+		static constexpr size_t digest_size = 48;
+		static constexpr size_t length_size = 16;
+
+		uint64_t state[8];
+
+		void init();
+		void compress(const std::byte *blocks, size_t count);
+		void store(std::byte *digest) const;
+	};
+
+	// Incremental SHA-2 hash, update() any number of times then finish() once
+	template <typename Engine>
+	class Sha {
+		public:
+			using Digest = std::array<std::byte, Engine::digest_size>;
+
+			Sha();
+
+			void update(std::span<const std::byte> data);
+			Digest finish();
+
+			static Digest digest(std::span<const std::byte> data);
+
+		private:
+			Engine engine;
+			std::array<std::byte, Engine::block_size> buffer;
+			size_t buffered = 0;
+			uint64_t length = 0;
+	};
+
+	using Sha256 = Sha<Sha256Engine>;
+	using Sha384 = Sha<Sha384Engine>;
+
+	// Lower case hex representation of a digest
+	std::string to_hex(std::span<const std::byte> digest);
+};
+
+#endif /* __SHA_HPP__ */
@@ -0,0 +1,159 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Copyright(c) 2023 Koko Software. All rights reserved.
+//
+// Author: Adrian Warecki <embedded@kokosoftware.pl>
+
+#include "types.hpp"
+#include "StringsIndex.hpp"
+
+#include <algorithm>
+#include <bit>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define STRINGS_SCAN_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+using namespace elf;
+
+// Each scanner appends position + 1 of every NUL found in data[pos, size)
+static void scan_scalar(const char *data, size_t pos, size_t size, std::vector<uint32_t> &out) {
+	while (pos < size) {
+		auto nul = static_cast<const char *>(std::memchr(data + pos, '\0', size - pos));
+		if (!nul)
+			break;
+
+		pos = nul - data + 1;
+		out.push_back(static_cast<uint32_t>(pos));
+	}
+}
+
+#ifdef STRINGS_SCAN_X86
+static void push_mask(size_t pos, uint32_t mask, std::vector<uint32_t> &out) {
+	while (mask) {
+		out.push_back(static_cast<uint32_t>(pos + std::countr_zero(mask) + 1));
+		mask &= mask - 1;
+	}
+}
+
+static void scan_sse2(const char *data, size_t size, std::vector<uint32_t> &out) {
+	const __m128i zero = _mm_setzero_si128();
+	size_t pos = 0;
+
+	for (; pos + 16 <= size; pos += 16) {
+		__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos));
+		push_mask(pos, _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, zero)), out);
+	}
+
+	scan_scalar(data, pos, size, out);
+}
+
+TARGET_AVX2
+static void scan_avx2(const char *data, size_t size, std::vector<uint32_t> &out) {
+	const __m256i zero = _mm256_setzero_si256();
+	size_t pos = 0;
+
+	for (; pos + 32 <= size; pos += 32) {
+		__m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + pos));
+		push_mask(pos, static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, zero))), out);
+	}
+
+	scan_scalar(data, pos, size, out);
+}
+
+static bool has_avx2() {
+#ifdef _MSC_VER
+	int info[4];
+
+	// OS must save the YMM registers
+	__cpuid(info, 1);
+	if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return info[1] & (1 << 5);
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+static void scan(const char *data, size_t size, std::vector<uint32_t> &out) {
+#ifdef STRINGS_SCAN_X86
+	static const bool avx2 = has_avx2();
+
+	if (avx2)
+		scan_avx2(data, size, out);
+	else
+		scan_sse2(data, size, out);
+#else
+	scan_scalar(data, 0, size, out);
+#endif
+}
+
+StringsIndex::StringsIndex(const StringsTable &table)
+	: table(table)
+{
+	auto data = table.data();
+	if (data.empty())
+		return;
+
+	if (data.size() > UINT32_MAX)
+		throw Exception("String table too large.");
+
+	// Rough guess of the average string length
+	offsets.reserve(data.size() / 16 + 1);
+	offsets.push_back(0);
+	scan(reinterpret_cast<const char *>(data.data()), data.size(), offsets);
+
+	// Terminator of the last string does not start a new one
+	if (offsets.back() == data.size())
+		offsets.pop_back();
+}
+
+bool StringsIndex::terminated() const {
+	auto data = table.data();
+	return !data.empty() && data.back() == std::byte(0);
+}
+
+std::string_view StringsIndex::operator[](size_t index) const {
+	auto data = table.data();
+	const size_t start = offsets[index];
+	size_t end = index + 1 < offsets.size() ? offsets[index + 1] - 1 : data.size();
+
+	if (index + 1 == offsets.size() && terminated())
+		end--;
+
+	return std::string_view(reinterpret_cast<const char *>(data.data()) + start, end - start);
+}
+
+bool StringsIndex::is_start(uint32_t offset) const {
+	return std::binary_search(offsets.begin(), offsets.end(), offset);
+}
+
+std::vector<uint32_t> StringsIndex::invalid(std::span<const Elf32_Sym> symbols) const {
+	std::vector<uint32_t> result;
+
+	for (size_t idx = 0; idx < symbols.size(); idx++)
+		if (!is_start(symbols[idx].name))
+			result.push_back(static_cast<uint32_t>(idx));
+
+	return result;
+}
+
+std::vector<uint32_t> StringsIndex::invalid(std::span<const SectionHeader> sections) const {
+	std::vector<uint32_t> result;
+
+	for (size_t idx = 0; idx < sections.size(); idx++)
+		if (!is_start(sections[idx].name))
+			result.push_back(static_cast<uint32_t>(idx));
+
+	return result;
+}
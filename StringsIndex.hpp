@@ -0,0 +1,44 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright(c) 2023 Koko Software. All rights reserved.
+ *
+ * Author: Adrian Warecki <embedded@kokosoftware.pl>
+ */
+
+#ifndef __STRINGS_INDEX_HPP__
+#define __STRINGS_INDEX_HPP__
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "Elf.hpp"
+
+namespace elf {
+	// Offsets of all strings in a string table, found by a single vectorized
+	// (AVX2 / SSE2 / scalar) scan for NUL terminators.
+	class StringsIndex {
+		public:
+			StringsIndex(const StringsTable &table);
+
+			size_t size() const { return offsets.size(); }
+			std::string_view operator[](size_t index) const;
+			const std::vector<uint32_t> &get_offsets() const { return offsets; }
+
+			// Last string of the table is NUL terminated
+			bool terminated() const;
+			bool is_start(uint32_t offset) const;
+
+			// Indexes of entries whose name does not point to a string start.
+			// Note that linkers may legally share string tails (".rela.text" and ".text").
+			std::vector<uint32_t> invalid(std::span<const Elf32_Sym> symbols) const;
+			std::vector<uint32_t> invalid(std::span<const SectionHeader> sections) const;
+
+		private:
+			StringsTable table;
+			std::vector<uint32_t> offsets;
+	};
+};
+
+#endif /* __STRINGS_INDEX_HPP__ */
@@ -0,0 +1,202 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Copyright(c) 2023 Koko Software. All rights reserved.
+//
+// Author: Adrian Warecki <embedded@kokosoftware.pl>
+
+#include "types.hpp"
+#include "SymbolResolver.hpp"
+#include "NameIndex.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+using namespace elf;
+
+SymbolResolver::SymbolResolver(ElfSet &set) {
+	ThreadPool pool;
+	build(set, pool);
+}
+
+SymbolResolver::SymbolResolver(ElfSet &set, ThreadPool &pool) {
+	build(set, pool);
+}
+
+SymbolResolver::Shard &SymbolResolver::shard(std::string_view name) const {
+	return shards[NameIndex::hash(name) % shard_count];
+}
+
+void SymbolResolver::build(ElfSet &set, ThreadPool &pool) {
+	tables.resize(set.size());
+	shards = std::make_unique<Shard[]>(shard_count);
+
+	std::mutex error_lock;
+	std::exception_ptr error;
+
+	// Each task reads its own file, only the shards are shared
+	for (size_t file = 0; file < set.size(); file++) {
+		Elf *elf = set[file].elf.get();
+		if (!elf)
+			continue;
+
+		pool.submit([this, elf, file, &error_lock, &error] {
+			try {
+				merge(*elf, file);
+			} catch (...) {
+				std::lock_guard<std::mutex> guard(error_lock);
+				if (!error)
+					error = std::current_exception();
+			}
+		});
+	}
+
+	pool.wait();
+
+	if (error)
+		std::rethrow_exception(error);
+
+	report(pool);
+}
+
+void SymbolResolver::merge(Elf &elf, size_t file) {
+	struct Item {
+		std::string_view name;
+		const Elf32_Sym *symbol;
+		Rank rank;	// None for an undefined reference
+	};
+
+	// Only exported symbols of linked files are visible to other files
+	const bool relocatable = elf.get_file_header().type == ET_REL;
+	int index = relocatable ? -1 : elf.find_section(".dynsym");
+	if (index < 0)
+		index = elf.find_section(".symtab");
+	if (index < 0)
+		return;
+
+	SymbolTable &table = tables[file];
+	elf.read_symbols(table, index);
+
+	// Group by shard first, so every shard is locked once per file
+	std::vector<std::vector<Item>> batches(shard_count);
+
+	for (const Elf32_Sym &sym : table.symbols()) {
+		const unsigned char bind = ELF32_ST_BIND(sym.info);
+		if (bind != STB_GLOBAL && bind != STB_WEAK && bind != STB_GNU_UNIQUE)
+			continue;
+
+		const std::string_view name = table.get_strings().get(sym.name);
+		if (name.empty())
+			continue;
+
+		Rank rank;
+		if (sym.shndx == SHN_UNDEF) {
+			if (bind == STB_WEAK)
+				continue;
+
+			rank = None;
+		} else {
+			const unsigned char visibility = ELF32_ST_VISIBILITY(sym.other);
+			if (!relocatable && (visibility == STV_HIDDEN || visibility == STV_INTERNAL))
+				continue;
+
+			if (sym.shndx == SHN_COMMON)
+				rank = Common;
+			else
+				rank = bind == STB_WEAK ? Weak : bind == STB_GNU_UNIQUE ? Unique : Global;
+		}
+
+		batches[NameIndex::hash(name) % shard_count].push_back({ name, &sym, rank });
+	}
+
+	for (unsigned int idx = 0; idx < shard_count; idx++) {
+		if (batches[idx].empty())
+			continue;
+
+		Shard &target = shards[idx];
+		std::lock_guard<std::mutex> guard(target.lock);
+
+		for (const Item &item : batches[idx]) {
+			Entry &entry = target.entries[item.name];
+
+			if (item.rank == None) {
+				entry.references.push_back(file);
+				continue;
+			}
+
+			// Recorded whatever wins, so reports do not depend on the merge order
+			if (item.rank == Global) {
+				if (entry.global == SIZE_MAX) {
+					entry.global = file;
+				} else {
+					if (entry.duplicates.empty())
+						entry.duplicates.push_back(entry.global);
+					entry.duplicates.push_back(file);
+				}
+			}
+
+			// Files are merged in any order, ties go to the lower index
+			if (item.rank > entry.rank || (item.rank == entry.rank && file < entry.definition.file)) {
+				entry.definition = { file, item.symbol };
+				entry.rank = item.rank;
+			}
+		}
+	}
+}
+
+// Collect conflicts and unresolved references of all shards in one pass
+void SymbolResolver::report(ThreadPool &pool) {
+	std::vector<std::vector<Report>> shard_conflicts(shard_count);
+	std::vector<std::vector<Report>> shard_unresolved(shard_count);
+
+	for (unsigned int idx = 0; idx < shard_count; idx++) {
+		pool.submit([this, idx, &shard_conflicts, &shard_unresolved] {
+			for (auto &[name, entry] : shards[idx].entries) {
+				// References bind to a unique definition, global ones do not clash then
+				if (!entry.duplicates.empty() && entry.rank != Unique) {
+					std::sort(entry.duplicates.begin(), entry.duplicates.end());
+					shard_conflicts[idx].push_back({ name, entry.duplicates });
+				}
+
+				if (entry.rank == None && !entry.references.empty()) {
+					std::sort(entry.references.begin(), entry.references.end());
+					shard_unresolved[idx].push_back({ name, entry.references });
+				}
+			}
+		});
+	}
+
+	pool.wait();
+
+	auto flatten = [](std::vector<std::vector<Report>> &parts, std::vector<Report> &out) {
+		for (std::vector<Report> &part : parts)
+			std::move(part.begin(), part.end(), std::back_inserter(out));
+
+		std::sort(out.begin(), out.end(), [](const Report &a, const Report &b) {
+			return a.name < b.name;
+		});
+	};
+
+	flatten(shard_conflicts, conflicts);
+	flatten(shard_unresolved, unresolved);
+}
+
+const SymbolResolver::Definition *SymbolResolver::find(std::string_view name) const {
+	const Shard &target = shard(name);
+
+	auto it = target.entries.find(name);
+	if (it == target.entries.end() || it->second.rank == None)
+		return nullptr;
+
+	return &it->second.definition;
+}
+
+size_t SymbolResolver::size() const {
+	size_t count = 0;
+
+	for (unsigned int idx = 0; idx < shard_count; idx++)
+		count += std::count_if(shards[idx].entries.begin(), shards[idx].entries.end(), [](const auto &item) {
+			return item.second.rank != None;
+		});
+
+	return count;
+}
@@ -0,0 +1,91 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright(c) 2023 Koko Software. All rights reserved.
+ *
+ * Author: Adrian Warecki <embedded@kokosoftware.pl>
+ */
+
+#ifndef __SYMBOL_RESOLVER_HPP__
+#define __SYMBOL_RESOLVER_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "Elf.hpp"
+#include "ElfSet.hpp"
+#include "ThreadPool.hpp"
+
+namespace elf {
+	// Global symbols of all files of a set merged into one table. Files are scanned
+	// concurrently, the table is split into shards with a lock each. Relocatable files
+	// use .symtab, other files .dynsym when present, hidden definitions of those are
+	// not exported. A STB_GNU_UNIQUE definition takes precedence over a global one, that
+	// over a common symbol and that over a weak definition, among equal ones the first
+	// file of the set wins. Unique definitions in several files are merged, not reported,
+	// and one suppresses the conflict between global definitions of the same name.
+	class SymbolResolver {
+		public:
+			struct Definition {
+				size_t file;		// Index in the set
+				const Elf32_Sym *symbol;
+			};
+
+			// Name with the files involved, in set order
+			struct Report {
+				std::string_view name;
+				std::vector<size_t> files;
+			};
+
+			SymbolResolver(ElfSet &set);
+			SymbolResolver(ElfSet &set, ThreadPool &pool);
+
+			// Provider of the symbol or nullptr
+			const Definition *find(std::string_view name) const;
+			// Symbols of the file, the table is empty if the file has none or failed to open
+			const SymbolTable &get_symbols(size_t file) const { return tables[file]; }
+
+			// Names defined as global in more than one file
+			const std::vector<Report> &get_conflicts() const { return conflicts; }
+			// Non-weak references without a definition in the set, weak ones may stay undefined
+			const std::vector<Report> &get_unresolved() const { return unresolved; }
+
+			size_t size() const;
+
+		private:
+			static constexpr unsigned int shard_count = 64;
+
+			enum Rank : uint8_t { None, Weak, Common, Global, Unique };
+
+			struct Entry {
+				Definition definition = { 0, nullptr };
+				Rank rank = None;
+				size_t global = SIZE_MAX;	// First file merged with a global definition
+				std::vector<size_t> duplicates;	// Files with a global definition once there are two
+				std::vector<size_t> references;	// Files with a non-weak undefined reference
+			};
+
+			struct Shard {
+				std::mutex lock;
+				std::unordered_map<std::string_view, Entry> entries;
+			};
+
+			std::vector<SymbolTable> tables;
+			std::unique_ptr<Shard[]> shards;
+			std::vector<Report> conflicts;
+			std::vector<Report> unresolved;
+
+			void build(ElfSet &set, ThreadPool &pool);
+			void merge(Elf &elf, size_t file);
+			void report(ThreadPool &pool);
+
+			Shard &shard(std::string_view name) const;
+	};
+};
+
+#endif /* __SYMBOL_RESOLVER_HPP__ */
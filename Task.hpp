@@ -0,0 +1,119 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright(c) 2023 Koko Software. All rights reserved.
+ *
+ * Author: Adrian Warecki <embedded@kokosoftware.pl>
+ */
+
+#ifndef __TASK_HPP__
+#define __TASK_HPP__
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+namespace elf {
+	template <typename T>
+	class Task;
+
+	// State shared by promises of all result types
+	class TaskPromiseBase {
+		public:
+			std::suspend_always initial_suspend() noexcept { return {}; }
+
+			// The awaiting coroutine continues in place of the finished one
+			struct Final {
+				bool await_ready() noexcept { return false; }
+				void await_resume() noexcept {}
+
+				template <typename Promise>
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+					return handle.promise().continuation;
+				}
+			};
+
+			Final final_suspend() noexcept { return {}; }
+
+			void unhandled_exception() { error = std::current_exception(); }
+
+			std::coroutine_handle<> continuation = std::noop_coroutine();
+
+		protected:
+			std::exception_ptr error;
+	};
+
+	template <typename T>
+	class TaskPromise : public TaskPromiseBase {
+		public:
+			Task<T> get_return_object();
+			void return_value(T result) { value.emplace(std::move(result)); }
+
+			T result() {
+				if (error)
+					std::rethrow_exception(error);
+
+				return std::move(*value);
+			}
+
+		private:
+			std::optional<T> value;
+	};
+
+	template <>
+	class TaskPromise<void> : public TaskPromiseBase {
+		public:
+			Task<void> get_return_object();
+			void return_void() {}
+
+			void result() {
+				if (error)
+					std::rethrow_exception(error);
+			}
+	};
+
+	// Lazily started coroutine. Awaiting the task runs it, the awaiter resumes when it
+	// finishes and receives its result or exception.
+	template <typename T = void>
+	class Task {
+		public:
+			using promise_type = TaskPromise<T>;
+
+			Task(Task &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+			Task &operator=(Task &&other) noexcept {
+				std::swap(handle, other.handle);
+				return *this;
+			}
+
+			~Task() {
+				if (handle)
+					handle.destroy();
+			}
+
+			bool await_ready() const noexcept { return false; }
+			T await_resume() { return handle.promise().result(); }
+
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept {
+				handle.promise().continuation = awaiter;
+				return handle;
+			}
+
+		private:
+			std::coroutine_handle<promise_type> handle;
+
+			explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+			friend promise_type;
+	};
+
+	template <typename T>
+	Task<T> TaskPromise<T>::get_return_object() {
+		return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+	}
+
+	inline Task<void> TaskPromise<void>::get_return_object() {
+		return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+	}
+};
+
+#endif /* __TASK_HPP__ */
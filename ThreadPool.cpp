@@ -0,0 +1,149 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Copyright(c) 2023 Koko Software. All rights reserved.
+//
+// Author: Adrian Warecki <embedded@kokosoftware.pl>
+
+#include "types.hpp"
+#include "ThreadPool.hpp"
+
+using namespace elf;
+
+// Pool and queue index of the calling worker thread
+static thread_local const ThreadPool *current_pool = nullptr;
+static thread_local unsigned int current_queue = 0;
+
+ThreadPool::ThreadPool(unsigned int threads)
+	: queued(0), unfinished(0), waiting(0), next(0), stop(false)
+{
+	if (!threads)
+		threads = 1;
+
+	for (unsigned int idx = 0; idx < threads; idx++)
+		queues.push_back(std::make_unique<Queue>());
+
+	for (unsigned int idx = 0; idx < threads; idx++)
+		workers.emplace_back(&ThreadPool::worker, this, idx);
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stop = true;
+	}
+
+	wake.notify_all();
+
+	for (std::thread &thread : workers)
+		thread.join();
+}
+
+void ThreadPool::submit(Task task) {
+	unsigned int target;
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		target = (current_pool == this) ? current_queue : static_cast<unsigned int>(next++ % queues.size());
+		unfinished++;
+		queued++;
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(queues[target]->lock);
+		queues[target]->tasks.push_back(std::move(task));
+	}
+
+	wake.notify_one();
+
+	// Tasks blocked in wait() run queued tasks too
+	std::lock_guard<std::mutex> guard(lock);
+	if (waiting)
+		idle.notify_all();
+}
+
+// Tasks blocked in wait() are not waited for, so nested waits do not deadlock
+void ThreadPool::wait() {
+	std::unique_lock<std::mutex> guard(lock);
+
+	if (current_pool != this) {
+		idle.wait(guard, [this] { return !unfinished; });
+		return;
+	}
+
+	// Called from a task, run queued tasks instead of blocking the worker
+	if (++waiting == unfinished)
+		idle.notify_all();
+
+	while (unfinished != waiting) {
+		if (!queued) {
+			idle.wait(guard);
+			continue;
+		}
+
+		queued--;
+		guard.unlock();
+
+		Task task;
+		while (!pop(current_queue, task))
+			std::this_thread::yield();
+
+		task();
+
+		guard.lock();
+		if (--unfinished == waiting)
+			idle.notify_all();
+	}
+
+	waiting--;
+}
+
+// Take the newest task of the own queue or steal the oldest one of another worker
+bool ThreadPool::pop(unsigned int self, Task &task) {
+	for (size_t idx = 0; idx < queues.size(); idx++) {
+		Queue &queue = *queues[(self + idx) % queues.size()];
+		std::lock_guard<std::mutex> guard(queue.lock);
+
+		if (queue.tasks.empty())
+			continue;
+
+		if (!idx) {
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+		} else {
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+void ThreadPool::worker(unsigned int self) {
+	current_pool = this;
+	current_queue = self;
+
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			wake.wait(guard, [this] { return stop || queued; });
+
+			if (!queued)
+				return;
+
+			// Reserve a task, it is in some queue already or being pushed
+			queued--;
+		}
+
+		Task task;
+		while (!pop(self, task))
+			std::this_thread::yield();
+
+		task();
+
+		std::lock_guard<std::mutex> guard(lock);
+		if (--unfinished == waiting)
+			idle.notify_all();
+	}
+}
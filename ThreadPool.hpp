@@ -0,0 +1,63 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright(c) 2023 Koko Software. All rights reserved.
+ *
+ * Author: Adrian Warecki <embedded@kokosoftware.pl>
+ */
+
+#ifndef __THREAD_POOL_HPP__
+#define __THREAD_POOL_HPP__
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace elf {
+	// Work stealing thread pool. Every worker has its own queue, tasks submitted
+	// from a worker go to its queue, idle workers steal from the others.
+	class ThreadPool {
+		public:
+			using Task = std::function<void()>;
+
+			ThreadPool(unsigned int threads = std::thread::hardware_concurrency());
+			~ThreadPool();
+
+			ThreadPool(const ThreadPool &) = delete;
+			ThreadPool &operator=(const ThreadPool &) = delete;
+
+			// Tasks must not throw
+			void submit(Task task);
+			// Wait until all submitted tasks are finished. Called from a task, the worker
+			// runs queued tasks meanwhile and tasks waiting the same way are not waited for.
+			void wait();
+
+			unsigned int size() const { return static_cast<unsigned int>(workers.size()); }
+
+		private:
+			struct Queue {
+				std::mutex lock;
+				std::deque<Task> tasks;
+			};
+
+			std::vector<std::unique_ptr<Queue>> queues;
+			std::vector<std::thread> workers;
+
+			std::mutex lock;
+			std::condition_variable wake;
+			std::condition_variable idle;
+			size_t queued;		// Tasks waiting in the queues
+			size_t unfinished;	// Tasks submitted and not finished yet
+			size_t waiting;		// Tasks blocked in wait()
+			size_t next;		// Queue for the next external submit
+			bool stop;
+
+			bool pop(unsigned int self, Task &task);
+			void worker(unsigned int self);
+	};
+};
+
+#endif /* __THREAD_POOL_HPP__ */
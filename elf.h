@@ -159,6 +159,7 @@ typedef struct {
 #define EM_ST100	60	/* STMicroelectronics ST100 processor. */
 #define EM_TINYJ	61	/* Advanced Logic Corp. TinyJ processor. */
 #define EM_X86_64	62	/* Advanced Micro Devices x86-64 */
+#define EM_XTENSA	94	/* Tensilica Xtensa Architecture */
 
 /* Non-standard or deprecated. */
 #define EM_486		6	/* Intel i486. */
@@ -198,6 +199,7 @@ typedef struct {
 #define SHT_SYMTAB_SHNDX	18	/* Section indexes (see SHN_XINDEX). */
 #define SHT_LOOS	0x60000000	/* First of OS specific semantics */
 #define SHT_HIOS	0x6fffffff	/* Last of OS specific semantics */
+#define SHT_GNU_HASH	0x6ffffff6	/* GNU style symbol hash table. */
 #define SHT_GNU_VERDEF	0x6ffffffd
 #define SHT_GNU_VERNEED	0x6ffffffe
 #define SHT_GNU_VERSYM	0x6fffffff
@@ -217,6 +219,7 @@ typedef struct {
 #define SHF_OS_NONCONFORMING	0x100	/* OS-specific processing required. */
 #define SHF_GROUP		0x200	/* Member of section group. */
 #define SHF_TLS			0x400	/* Section contains TLS data. */
+#define SHF_COMPRESSED		0x800	/* Section contains compressed data. */
 #define SHF_MASKOS	0x0ff00000	/* OS-specific semantics. */
 #define SHF_MASKPROC	0xf0000000	/* Processor-specific semantics. */
 
@@ -296,6 +299,8 @@ typedef struct {
 #define	DT_LOPROC	0x70000000	/* First processor-specific type. */
 #define	DT_HIPROC	0x7fffffff	/* Last processor-specific type. */
 
+#define	DT_GNU_HASH	0x6ffffef5	/* Address of GNU style hash table. */
+
 #define	DT_VERNEED	0x6ffffffe
 #define	DT_VERNEEDNUM	0x6fffffff
 #define	DT_VERSYM	0x6ffffff0
@@ -325,6 +330,7 @@ typedef struct {
 #define STB_GLOBAL	1	/* Global symbol */
 #define STB_WEAK	2	/* like global - lower precedence */
 #define STB_LOOS	10	/* Reserved range for operating system */
+#define STB_GNU_UNIQUE	10	/* Unique symbol (GNU). */
 #define STB_HIOS	12	/*   specific semantics. */
 #define STB_LOPROC	13	/* reserved range for processor */
 #define STB_HIPROC	15	/*   specific semantics. */
@@ -406,6 +412,24 @@ typedef struct {
 	Elf32_Word	entsize;	/* Size of each entry in section. */
 } Elf32_Shdr;
 
+/*
+ * Compression header, at the start of SHF_COMPRESSED sections.
+ */
+
+typedef struct {
+	Elf32_Word	type;		/* Compression format. */
+	Elf32_Word	size;		/* Uncompressed data size. */
+	Elf32_Word	addralign;	/* Uncompressed data alignment. */
+} Elf32_Chdr;
+
+/* Values for ch_type. */
+#define ELFCOMPRESS_ZLIB	1	/* ZLIB/DEFLATE algorithm. */
+#define ELFCOMPRESS_ZSTD	2	/* Zstandard algorithm. */
+#define ELFCOMPRESS_LOOS	0x60000000	/* First OS-specific. */
+#define ELFCOMPRESS_HIOS	0x6fffffff	/* Last OS-specific. */
+#define ELFCOMPRESS_LOPROC	0x70000000	/* First processor-specific type. */
+#define ELFCOMPRESS_HIPROC	0x7fffffff	/* Last processor-specific type. */
+
 /*
  * Program header.
  */
@@ -742,6 +766,28 @@ typedef struct {
 #define	R_SPARC_UA16		55
 
 
+#define	R_XTENSA_NONE		0
+#define	R_XTENSA_32		1
+#define	R_XTENSA_RTLD		2
+#define	R_XTENSA_GLOB_DAT	3
+#define	R_XTENSA_JMP_SLOT	4
+#define	R_XTENSA_RELATIVE	5
+#define	R_XTENSA_PLT		6
+#define	R_XTENSA_OP0		8
+#define	R_XTENSA_OP1		9
+#define	R_XTENSA_OP2		10
+#define	R_XTENSA_ASM_EXPAND	11
+#define	R_XTENSA_ASM_SIMPLIFY	12
+#define	R_XTENSA_32_PCREL	14
+#define	R_XTENSA_GNU_VTINHERIT	15
+#define	R_XTENSA_GNU_VTENTRY	16
+#define	R_XTENSA_DIFF8		17
+#define	R_XTENSA_DIFF16		18
+#define	R_XTENSA_DIFF32		19
+#define	R_XTENSA_SLOT0_OP	20
+#define	R_XTENSA_SLOT0_ALT	35
+
+
 /*
  * Magic number for the elf trampoline, chosen wisely to be an immediate
  * value.
@@ -841,6 +887,17 @@ struct Elf64_Shdr {
 	Elf64_Xword	entsize;	/* Size of each entry in section. */
 };
 
+/*
+ * Compression header.
+ */
+
+typedef struct {
+	Elf64_Word	type;		/* Compression format. */
+	Elf64_Word	reserved;
+	Elf64_Xword	size;		/* Uncompressed data size. */
+	Elf64_Xword	addralign;	/* Uncompressed data alignment. */
+} Elf64_Chdr;
+
 /*
  * Program header.
  */
@@ -10,6 +10,7 @@
 
 #include <stdio.h>
 
+#include <cstring>
 #include <string>
 #include <exception>
 #include <stdexcept>